@@ -61,6 +61,7 @@
 				'src/isolate/environment.cc',
 				'src/isolate/holder.cc',
 				'src/isolate/inspector.cc',
+				'src/isolate/pool.cc',
 				'src/isolate/stack_trace.cc',
 				'src/isolate/three_phase_task.cc',
 				'src/context_handle.cc',
@@ -72,6 +73,7 @@
 				'src/native_module_handle.cc',
 				'src/reference_handle.cc',
 				'src/script_handle.cc',
+				'src/script_template_handle.cc',
 				'src/module_handle.cc',
 				'src/session_handle.cc',
 				'src/transferable.cc',
@@ -8,6 +8,7 @@ declare module "isolated-vm" {
 		| Isolate
 		| Context
 		| Script
+		| ScriptTemplate
 		| ExternalCopy<any>
 		| Copy<any>
 		| Reference<any>
@@ -38,6 +39,25 @@ declare module "isolated-vm" {
 			warmup_script?: string
 		): ExternalCopy<ArrayBuffer>;
 
+		/**
+		 * Asynchronous version of `new Isolate(options)` which builds the isolate on
+		 * the thread pool instead of blocking the event loop.
+		 */
+		static create(options?: IsolateOptions): Promise<Isolate>;
+
+		/**
+		 * Changes the number of threads isolates may run on. If `group` is
+		 * passed then a reserved pool group is created or resized instead, which
+		 * isolates can join with the `threadPool` option.
+		 */
+		static setThreadPoolSize(size: number, group?: string): void;
+
+		/**
+		 * Keeps `size` isolates built ahead of time for `new Isolate(options)` with
+		 * the same `memoryLimit` and `snapshot`.
+		 */
+		static setPoolSize(size: number, options?: IsolatePoolOptions): void;
+
 		compileScript(code: string, scriptInfo?: ScriptInfo): Promise<Script>;
 
 		compileScriptSync(code: string, scriptInfo?: ScriptInfo): Script;
@@ -125,6 +145,51 @@ declare module "isolated-vm" {
 		snapshot?: ExternalCopy<ArrayBuffer>;
 
 		inspector?: boolean;
+
+		/**
+		 * Name of a thread pool group created with `Isolate.setThreadPoolSize`.
+		 */
+		threadPool?: string;
+
+		/**
+		 * Number of spare contexts to build ahead of time for `createContext`.
+		 */
+		contextPoolSize?: number;
+
+		/**
+		 * Limits CPU time used by async work over a rolling window. Isolates which
+		 * are over their quota are deferred.
+		 */
+		cpuQuota?: CpuQuotaOptions;
+
+		/**
+		 * Directory of compiled code which `compileScript` and `compileModule` will
+		 * consult and fill automatically. Entries are named by a hash of the source
+		 * and the v8 version and flags, so it can be shared between processes.
+		 */
+		codeCache?: string;
+	}
+
+	export interface CpuQuotaOptions {
+		/**
+		 * CPU time in milliseconds allowed per window.
+		 */
+		limit: number;
+
+		/**
+		 * Length of the rolling window in milliseconds. Default is 1000.
+		 */
+		window?: number;
+
+		/**
+		 * Isolates with the same group name share one quota.
+		 */
+		group?: string;
+	}
+
+	export interface IsolatePoolOptions {
+		memoryLimit?: number;
+		snapshot?: ExternalCopy<ArrayBuffer>;
 	}
 
 	export interface ContextOptions {
@@ -218,12 +283,44 @@ declare module "isolated-vm" {
 		runSync(context: Context, options?: ScriptRunOptions): any;
 	}
 
+	/**
+	 * Source code which can be compiled into any number of isolates. The first
+	 * compile produces a code cache which every other isolate deserializes from.
+	 */
+	export class ScriptTemplate {
+		constructor(code: string, scriptInfo?: ScriptInfo);
+
+		/**
+		 * Compiles this template into an isolate. Each isolate's script is kept, so
+		 * compiling into the same isolate again returns the same script.
+		 */
+		compile(isolate: Isolate): Promise<Script>;
+
+		compileSync(isolate: Isolate): Script;
+	}
+
 	export interface ScriptRunOptions {
 		/**
 		 * Maximum amount of time this script is allowed to run before execution is
 		 * canceled. Default is no timeout.
 		 */
 		timeout?: number;
+
+		/**
+		 * Maximum amount of CPU time this script is allowed to consume before
+		 * execution is canceled. Unlike `timeout` this isn't affected by the host
+		 * being busy with other work. Default is no timeout.
+		 */
+		cpuTimeout?: number;
+	}
+
+	export interface ApplyOptions extends ScriptRunOptions {
+		/**
+		 * If the function returns a promise, wait for it to settle inside the target
+		 * isolate and resolve with its result. No thread is held while waiting. The
+		 * timeout only covers the synchronous part of the call.
+		 */
+		promise?: boolean;
 	}
 
 	export interface ModuleEvaluateOptions {
@@ -231,6 +328,11 @@ declare module "isolated-vm" {
 		 * Maximum amount of time this module is allowed to run before execution is canceled. Default is no timeout.
 		 */
 		timeout: number;
+
+		/**
+		 * Maximum amount of CPU time this module is allowed to consume before execution is canceled. Default is no timeout.
+		 */
+		cpuTimeout?: number;
 	}
 
 	/**
@@ -384,7 +486,7 @@ declare module "isolated-vm" {
 		apply(
 			receiver?: any,
 			arguments?: Transferable[],
-			options?: ScriptRunOptions
+			options?: ApplyOptions
 		): Promise<any>;
 
 		applyIgnored(
@@ -421,6 +523,26 @@ declare module "isolated-vm" {
 			arguments?: Transferable[],
 			options?: ScriptRunOptions
 		): any;
+
+		/**
+		 * Invokes the function once for each `[ receiver, arguments ]` pair in a
+		 * single task in the target isolate. Returns the results in order. The
+		 * timeout applies to the whole batch, and the first error aborts it.
+		 */
+		applyBatch(
+			calls: [any, Transferable[]?][],
+			options?: ScriptRunOptions
+		): Promise<any[]>;
+
+		applyBatchIgnored(
+			calls: [any, Transferable[]?][],
+			options?: ScriptRunOptions
+		): void;
+
+		applyBatchSync(
+			calls: [any, Transferable[]?][],
+			options?: ScriptRunOptions
+		): any[];
 	}
 
 	export interface AutomaticallyReleasableOptions {
@@ -437,6 +559,14 @@ declare module "isolated-vm" {
 		 * arbitrarily large object. This only applies to ArrayBuffer and TypedArray instances.
 		 */
 		transferOut?: boolean;
+
+		/**
+		 * If the value is an array it will be serialized in slices of roughly this many
+		 * bytes. When copied with `transferIn` each slice is freed as soon as it has been
+		 * copied, and the memory limit is checked before each slice. Object identity is
+		 * only preserved within a slice.
+		 */
+		chunkSize?: number;
 	}
 
 	export interface ExternalCopyCopyOptions
@@ -446,6 +576,20 @@ declare module "isolated-vm" {
 		 * invalidating the ExternalCopy handle.
 		 */
 		transferIn?: boolean;
+
+		/**
+		 * If true a copy of an ArrayBuffer will be internalized as a
+		 * SharedArrayBuffer which references the same memory instead of copying
+		 * it. This memory is not counted against the isolate's memory limit.
+		 */
+		shared?: boolean;
+
+		/**
+		 * If true the internalized value will be deeply frozen and cached in this
+		 * isolate, and later copies of the same ExternalCopy into the same context
+		 * return the same object.
+		 */
+		cache?: boolean;
 	}
 
 	/**
@@ -478,6 +622,19 @@ declare module "isolated-vm" {
 		 */
 		static totalExternalSize: number;
 
+		/**
+		 * Returns a copy of an ArrayBuffer which is backed by a memory mapping of
+		 * the given file. Nothing is read up front, and pages are only copied if
+		 * an isolate writes to them.
+		 */
+		static fromFile(path: string): ExternalCopy<ArrayBuffer>;
+
+		/**
+		 * ArrayBuffers of at least this many bytes are copied in parallel using
+		 * the thread pool. Pass 0 to disable. The default is 16MB.
+		 */
+		static setParallelCopyThreshold(bytes: number): void;
+
 		/**
 		 * Internalizes the ExternalCopy data into this isolate.
 		 *
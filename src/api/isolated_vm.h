@@ -10,6 +10,7 @@
 #include "../isolate/remote_handle.h"
 #include "../isolate/runnable.h"
 #include <memory>
+#include <string>
 
 namespace isolated_vm {
 	using Runnable = ivm::Runnable;
@@ -51,6 +52,12 @@ namespace isolated_vm {
 			}
 	};
 
+	// Resizes the isolate thread pool. If `group` is not empty a reserved pool group is resized (or
+	// created) instead, which isolates can join with the `threadPool` option.
+	inline void SetThreadPoolSize(size_t size, const std::string& group = "") {
+		ivm::IsolateEnvironment::Scheduler::SetThreadPoolSize(size, group);
+	}
+
 	template <typename T>
 	class RemoteHandle {
 		private:
@@ -0,0 +1,218 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// This file contains no v8 code and is therefore free from v8's naming conventions
+
+/**
+ * Directory of compiled code caches. Entries are named by a SHA-256 of the source and a fingerprint
+ * of the compiler (v8 version and flags), so any number of processes can share a directory and an
+ * entry never needs to be invalidated. Entries are written to a temporary file and renamed into
+ * place, so a reader only ever sees a complete entry and existing files are never modified.
+ */
+class code_cache_store_t {
+	private:
+		std::string directory;
+
+		class sha256_t {
+			private:
+				std::array<uint32_t, 8> state {{
+					0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+				}};
+				std::array<uint8_t, 64> block;
+				size_t block_length = 0;
+				uint64_t total_length = 0;
+
+				static uint32_t rotate(uint32_t value, int bits) {
+					return (value >> bits) | (value << (32 - bits));
+				}
+
+				void transform() {
+					static constexpr uint32_t k[64] = {
+						0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+						0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+						0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+						0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+						0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+						0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+						0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+						0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+					};
+					uint32_t w[64];
+					for (int ii = 0; ii < 16; ++ii) {
+						w[ii] = uint32_t{block[ii * 4]} << 24 | uint32_t{block[ii * 4 + 1]} << 16 | uint32_t{block[ii * 4 + 2]} << 8 | uint32_t{block[ii * 4 + 3]};
+					}
+					for (int ii = 16; ii < 64; ++ii) {
+						uint32_t s0 = rotate(w[ii - 15], 7) ^ rotate(w[ii - 15], 18) ^ (w[ii - 15] >> 3);
+						uint32_t s1 = rotate(w[ii - 2], 17) ^ rotate(w[ii - 2], 19) ^ (w[ii - 2] >> 10);
+						w[ii] = w[ii - 16] + s0 + w[ii - 7] + s1;
+					}
+					std::array<uint32_t, 8> v = state;
+					for (int ii = 0; ii < 64; ++ii) {
+						uint32_t s1 = rotate(v[4], 6) ^ rotate(v[4], 11) ^ rotate(v[4], 25);
+						uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+						uint32_t t1 = v[7] + s1 + ch + k[ii] + w[ii];
+						uint32_t s0 = rotate(v[0], 2) ^ rotate(v[0], 13) ^ rotate(v[0], 22);
+						uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+						uint32_t t2 = s0 + maj;
+						v = {{ t1 + t2, v[0], v[1], v[2], v[3] + t1, v[4], v[5], v[6] }};
+					}
+					for (int ii = 0; ii < 8; ++ii) {
+						state[ii] += v[ii];
+					}
+				}
+
+			public:
+				void update(const void* data, size_t length) {
+					auto bytes = static_cast<const uint8_t*>(data);
+					total_length += length;
+					while (length != 0) {
+						size_t count = std::min(length, block.size() - block_length);
+						std::memcpy(&block[block_length], bytes, count);
+						block_length += count;
+						bytes += count;
+						length -= count;
+						if (block_length == block.size()) {
+							transform();
+							block_length = 0;
+						}
+					}
+				}
+
+				std::string hex_digest() {
+					uint64_t bits = total_length * 8;
+					uint8_t padding[72] = { 0x80 };
+					size_t padding_length = (block_length < 56 ? 56 : 120) - block_length;
+					for (int ii = 0; ii < 8; ++ii) {
+						padding[padding_length + ii] = static_cast<uint8_t>(bits >> (56 - ii * 8));
+					}
+					update(padding, padding_length + 8);
+					static constexpr char digits[] = "0123456789abcdef";
+					std::string hex;
+					for (uint32_t word : state) {
+						for (int shift = 28; shift >= 0; shift -= 4) {
+							hex += digits[(word >> shift) & 0xf];
+						}
+					}
+					return hex;
+				}
+		};
+
+		std::string path(const std::string& key) const {
+			return directory + "/" + key;
+		}
+
+	public:
+		explicit code_cache_store_t(std::string directory) : directory(std::move(directory)) {}
+		code_cache_store_t(const code_cache_store_t&) = delete;
+		code_cache_store_t& operator= (const code_cache_store_t&) = delete;
+
+		/**
+		 * Returns the entry name for some source. `fingerprint` should change whenever the compiler
+		 * would produce incompatible output, and `kind` separates different kinds of code (ie scripts
+		 * and modules) compiled from the same source.
+		 */
+		static std::string key(uint32_t fingerprint, const char* kind, bool one_byte, const void* data, size_t length) {
+			sha256_t hash;
+			uint8_t header[5] = {
+				static_cast<uint8_t>(fingerprint >> 24), static_cast<uint8_t>(fingerprint >> 16),
+				static_cast<uint8_t>(fingerprint >> 8), static_cast<uint8_t>(fingerprint),
+				static_cast<uint8_t>(one_byte),
+			};
+			hash.update(header, sizeof(header));
+			hash.update(data, length);
+			return std::string(kind) + "-" + hash.hex_digest();
+		}
+
+		/**
+		 * Returns the contents of an entry, or nullptr if there is no such entry or it can't be read.
+		 * On POSIX systems this is a read-only mapping of the file.
+		 */
+		std::shared_ptr<void> load(const std::string& key, size_t& length) const {
+			std::string file_path = path(key);
+#ifdef _WIN32
+			FILE* file = std::fopen(file_path.c_str(), "rb");
+			if (file == nullptr) {
+				return nullptr;
+			}
+			std::shared_ptr<FILE> file_ptr(file, std::fclose);
+			if (std::fseek(file, 0, SEEK_END) != 0) {
+				return nullptr;
+			}
+			long size = std::ftell(file);
+			if (size <= 0 || std::fseek(file, 0, SEEK_SET) != 0) {
+				return nullptr;
+			}
+			std::shared_ptr<void> data(std::malloc(size), std::free);
+			if (!data || std::fread(data.get(), 1, size, file) != static_cast<size_t>(size)) {
+				return nullptr;
+			}
+			length = size;
+			return data;
+#else
+			int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd == -1) {
+				return nullptr;
+			}
+			struct stat info;
+			if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+				::close(fd);
+				return nullptr;
+			}
+			size_t size = info.st_size;
+			void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (data == MAP_FAILED) {
+				return nullptr;
+			}
+			length = size;
+			return std::shared_ptr<void>(data, [size](void* ptr) { ::munmap(ptr, size); });
+#endif
+		}
+
+		/**
+		 * Writes an entry, replacing any existing entry with the same key. Returns false if the entry
+		 * couldn't be written, which callers are free to ignore.
+		 */
+		bool store(const std::string& key, const void* data, size_t length) const {
+			static std::atomic<unsigned> counter{0};
+			std::string file_path = path(key);
+#ifdef _WIN32
+			int pid = _getpid();
+#else
+			int pid = ::getpid();
+#endif
+			// Unique per process and call so concurrent writers never share a temporary file
+			std::string temp_path = file_path + ".tmp" + std::to_string(pid) + "-" + std::to_string(counter++);
+			FILE* file = std::fopen(temp_path.c_str(), "wb");
+			if (file == nullptr) {
+				return false;
+			}
+			bool written = std::fwrite(data, 1, length, file) == length;
+			written = std::fclose(file) == 0 && written;
+#ifdef _WIN32
+			// rename() won't replace an existing file on Windows
+			std::remove(file_path.c_str());
+#endif
+			if (!written || std::rename(temp_path.c_str(), file_path.c_str()) != 0) {
+				std::remove(temp_path.c_str());
+				return false;
+			}
+			return true;
+		}
+};
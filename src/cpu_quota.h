@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// This file contains no v8 code and is therefore free from v8's naming conventions
+
+/**
+ * Tracks CPU time spent by one or more isolates over a rolling window. The window is split into
+ * buckets and usage is the sum of the buckets which are still inside the window. Once usage goes
+ * over `limit` the owners should be throttled until enough old buckets fall out of the window.
+ */
+class cpu_quota_t {
+	public:
+		using clock = std::chrono::steady_clock;
+		using duration = std::chrono::nanoseconds;
+
+	private:
+		static constexpr int64_t kBuckets = 10;
+		struct bucket_t {
+			int64_t index = -1;
+			duration used{};
+		};
+
+		std::mutex mutex;
+		const clock::time_point epoch = clock::now();
+		duration limit;
+		duration bucket_size{};
+		std::array<bucket_t, kBuckets> buckets;
+
+		int64_t current_index(clock::time_point now) const {
+			return (now - epoch) / bucket_size;
+		}
+
+		bucket_t& bucket_at(int64_t index) {
+			return buckets[index % kBuckets];
+		}
+
+		// Mutex must be held
+		duration usage(int64_t index) {
+			duration used{};
+			for (int64_t ii = std::max(index - kBuckets + 1, int64_t{0}); ii <= index; ++ii) {
+				if (bucket_at(ii).index == ii) {
+					used += bucket_at(ii).used;
+				}
+			}
+			return used;
+		}
+
+	public:
+		cpu_quota_t(duration limit, duration window) {
+			set(limit, window);
+		}
+		cpu_quota_t(const cpu_quota_t&) = delete;
+		cpu_quota_t& operator= (const cpu_quota_t&) = delete;
+
+		// Changes the limit and window. Usage so far is kept, so this can't be used to dodge the quota.
+		void set(duration limit, duration window) {
+			std::lock_guard<std::mutex> lock(mutex);
+			this->limit = limit;
+			duration size = std::max(duration{window.count() / kBuckets}, duration{1});
+			if (size != bucket_size) {
+				// Old buckets don't line up with the new window, so carry everything that was still inside
+				// the old window into the current bucket of the new one
+				duration used{};
+				if (bucket_size != duration{}) {
+					used = usage(current_index(clock::now()));
+				}
+				bucket_size = size;
+				buckets = {};
+				int64_t index = current_index(clock::now());
+				bucket_at(index) = { index, used };
+			}
+		}
+
+		// Adds CPU time used by an owner
+		void charge(duration time) {
+			std::lock_guard<std::mutex> lock(mutex);
+			int64_t index = current_index(clock::now());
+			bucket_t& bucket = bucket_at(index);
+			if (bucket.index != index) {
+				bucket.index = index;
+				bucket.used = {};
+			}
+			bucket.used += time;
+		}
+
+		// Returns how long the owners should wait before running again, or zero if they're under the
+		// limit
+		duration throttle() {
+			std::lock_guard<std::mutex> lock(mutex);
+			clock::time_point now = clock::now();
+			int64_t index = current_index(now);
+			int64_t oldest = std::max(index - kBuckets + 1, int64_t{0});
+			duration used = usage(index);
+			if (used < limit) {
+				return {};
+			}
+			// Find the first bucket which brings usage back under the limit when it expires
+			for (int64_t ii = oldest; ii <= index; ++ii) {
+				if (bucket_at(ii).index == ii) {
+					used -= bucket_at(ii).used;
+					if (used < limit) {
+						return epoch + bucket_size * (ii + kBuckets) - now;
+					}
+				}
+			}
+			return bucket_size;
+		}
+
+		/**
+		 * Returns the quota shared by every isolate in the named group. The most recent limits apply
+		 * to the whole group, but joining a group never resets its usage.
+		 */
+		static std::shared_ptr<cpu_quota_t> group(const std::string& name, duration limit, duration window) {
+			// These are never destroyed because isolates may outlive static destructors
+			static auto groups_mutex = new std::mutex;
+			static auto groups = new std::unordered_map<std::string, std::weak_ptr<cpu_quota_t>>;
+			std::lock_guard<std::mutex> lock(*groups_mutex);
+			auto& weak = (*groups)[name];
+			auto quota = weak.lock();
+			if (quota) {
+				quota->set(limit, window);
+			} else {
+				quota = std::make_shared<cpu_quota_t>(limit, window);
+				weak = quota;
+			}
+			return quota;
+		}
+};
@@ -8,7 +8,19 @@
 #include "isolate/v8_version.h"
 
 #include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
 #include <cstring>
+#include <thread>
+#ifdef _WIN32
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace v8;
 using std::make_unique;
@@ -265,12 +277,28 @@ void ExternalCopy::UpdateSize(size_t size) {
  * ExternalCopyString implementation
  */
 
+// Statics
+std::mutex ExternalCopyString::resources_mutex;
+std::unordered_set<const String::ExternalStringResourceBase*> ExternalCopyString::resources;
+
+void ExternalCopyString::RegisterResource(const String::ExternalStringResourceBase* resource) {
+	std::lock_guard<std::mutex> lock(resources_mutex);
+	resources.insert(resource);
+}
+
+void ExternalCopyString::UnregisterResource(const String::ExternalStringResourceBase* resource) {
+	std::lock_guard<std::mutex> lock(resources_mutex);
+	resources.erase(resource);
+}
+
 // External two byte
 ExternalCopyString::ExternalString::ExternalString(shared_ptr<V> value) : value(std::move(value)) {
 	IsolateEnvironment::GetCurrent()->extra_allocated_memory += this->value->size();
+	RegisterResource(this);
 }
 
 ExternalCopyString::ExternalString::~ExternalString() {
+	UnregisterResource(this);
 	IsolateEnvironment::GetCurrent()->extra_allocated_memory -= this->value->size();
 }
 
@@ -285,9 +313,11 @@ size_t ExternalCopyString::ExternalString::length() const {
 // External one byte
 ExternalCopyString::ExternalStringOneByte::ExternalStringOneByte(shared_ptr<V> value) : value(std::move(value)) {
 	IsolateEnvironment::GetCurrent()->extra_allocated_memory += this->value->size();
+	RegisterResource(this);
 }
 
 ExternalCopyString::ExternalStringOneByte::~ExternalStringOneByte() {
+	UnregisterResource(this);
 	IsolateEnvironment::GetCurrent()->extra_allocated_memory -= this->value->size();
 }
 
@@ -299,9 +329,38 @@ size_t ExternalCopyString::ExternalStringOneByte::length() const {
 	return value->size();
 }
 
+// If this string is backed by one of our own external resources then the underlying buffer can be
+// shared instead of copied. This is what happens to large strings which are passed back and forth
+// between isolates. Strings externalized by anyone else belong to that isolate's heap and will be
+// copied.
+bool ExternalCopyString::ShareExternal(Local<String> string) {
+	String::Encoding encoding;
+	auto resource = string->GetExternalStringResourceBase(&encoding);
+	if (resource == nullptr) {
+		return false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(resources_mutex);
+		if (resources.find(resource) == resources.end()) {
+			return false;
+		}
+	}
+	// The string is alive in the current isolate so the resource can't be freed out from under us
+	if (encoding == String::Encoding::ONE_BYTE_ENCODING) {
+		one_byte = true;
+		value = static_cast<ExternalStringOneByte*>(resource)->shared();
+	} else {
+		one_byte = false;
+		value = static_cast<ExternalString*>(resource)->shared();
+	}
+	return true;
+}
+
 // External copy
 ExternalCopyString::ExternalCopyString(Local<String> string) : ExternalCopy((string->Length() << (string->IsOneByte() ? 0 : 1)) + sizeof(ExternalCopyString)) {
-	if (string->IsOneByte()) {
+	if (ShareExternal(string)) {
+		return;
+	} else if (string->IsOneByte()) {
 		one_byte = true;
 		value = std::make_shared<V>(string->Length());
 #if V8_AT_LEAST(6, 9, 408)
@@ -396,6 +455,246 @@ Local<Value> ExternalCopySerialized::CopyInto(bool transfer_in) {
 	}
 }
 
+/**
+ * ExternalCopyCache implementation
+ */
+ExternalCopyCache::ExternalCopyCache(size_t budget) : budget{budget} {}
+
+bool ExternalCopyCache::IsCacheable(const ExternalCopy& copy) {
+	return dynamic_cast<const ExternalCopySerialized*>(&copy) != nullptr;
+}
+
+Local<Value> ExternalCopyCache::CopyInto(const shared_ptr<ExternalCopy>& copy) {
+	Isolate* isolate = Isolate::GetCurrent();
+	Local<Context> context = isolate->GetCurrentContext();
+	Key key{copy.get(), context->Global()->GetIdentityHash()};
+	auto range = entries.equal_range(key);
+	for (auto ii = range.first; ii != range.second; ++ii) {
+		Entry& entry = ii->second;
+		if (entry.context.Get(isolate) == context) {
+			// The address may belong to a new copy if the original was destroyed
+			if (entry.copy.lock() == copy) {
+				lru.splice(lru.end(), lru, entry.lru);
+				return Unmaybe(context->Global()->GetPrivate(context, entry.key.Get(isolate)));
+			}
+			Evict(ii);
+			break;
+		}
+	}
+	Local<Value> value = copy->CopyIntoCheckHeap();
+	Freeze(context, value);
+	size_t copy_size = copy->OriginalSize();
+	if (copy_size > budget) {
+		return value;
+	}
+	if (entries.size() >= sweep_at) {
+		Sweep();
+	}
+	while (size + copy_size > budget) {
+		Evict(Find(lru.front()));
+	}
+	Local<Private> private_key = Private::New(isolate);
+	Unmaybe(context->Global()->SetPrivate(context, private_key, value));
+	Entry& entry = entries.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple())->second;
+	entry.cache = this;
+	entry.copy = copy;
+	entry.context.Reset(isolate, context);
+	entry.context.SetWeak(&entry, &WeakCallbackV8, WeakCallbackType::kParameter);
+	entry.key.Reset(isolate, private_key);
+	entry.size = copy_size;
+	entry.lru = lru.emplace(lru.end(), key, &entry);
+	size += copy_size;
+	return value;
+}
+
+ExternalCopyCache::entry_map_t::iterator ExternalCopyCache::Find(const lru_list_t::value_type& item) {
+	auto range = entries.equal_range(item.first);
+	for (auto ii = range.first; ii != range.second; ++ii) {
+		if (&ii->second == item.second) {
+			return ii;
+		}
+	}
+	throw std::logic_error("ExternalCopyCache entry is missing");
+}
+
+void ExternalCopyCache::Evict(entry_map_t::iterator it) {
+	Entry& entry = it->second;
+	if (!entry.context.IsEmpty()) {
+		Isolate* isolate = Isolate::GetCurrent();
+		HandleScope handle_scope(isolate);
+		Local<Context> context = entry.context.Get(isolate);
+		Unmaybe(context->Global()->DeletePrivate(context, entry.key.Get(isolate)));
+	}
+	size -= entry.size;
+	lru.erase(entry.lru);
+	entries.erase(it);
+}
+
+void ExternalCopyCache::Sweep() {
+	// Drop entries for copies which have been destroyed or contexts which have been collected. The next
+	// sweep waits until the cache has doubled in size, so each miss pays a constant amount on average.
+	for (auto ii = entries.begin(); ii != entries.end(); ) {
+		auto next = std::next(ii);
+		if (ii->second.copy.expired() || ii->second.context.IsEmpty()) {
+			Evict(ii);
+		}
+		ii = next;
+	}
+	sweep_at = std::max(size_t{kMinimumSweep}, entries.size() * 2);
+}
+
+void ExternalCopyCache::WeakCallbackV8(const WeakCallbackInfo<Entry>& info) {
+	// The value went away with its context. The entry itself is left for `Sweep` since this runs in
+	// the middle of garbage collection, which can happen while the cache is being walked.
+	Entry& entry = *info.GetParameter();
+	entry.context.Reset();
+	entry.cache->size -= entry.size;
+	entry.size = 0;
+}
+
+void ExternalCopyCache::Freeze(Local<Context> context, Local<Value> value) {
+	// Walk the object graph without recursion since it may be arbitrarily deep. Visited objects are
+	// tracked by identity hash, which isn't unique, so collisions are compared directly.
+	std::unordered_multimap<int, Local<Object>> visited;
+	std::vector<Local<Object>> stack;
+	auto visit = [&](Local<Value> value) {
+		if (!value->IsObject()) {
+			return;
+		}
+		Local<Object> object = value.As<Object>();
+		int hash = object->GetIdentityHash();
+		auto range = visited.equal_range(hash);
+		for (auto ii = range.first; ii != range.second; ++ii) {
+			if (ii->second == object) {
+				return;
+			}
+		}
+		if (
+			object->IsArrayBuffer() || object->IsArrayBufferView() || object->IsSharedArrayBuffer() ||
+			object->IsMap() || object->IsSet() || object->IsDate()
+		) {
+			throw js_type_error("`cache` can't be used with values containing binary data, Map, Set, or Date");
+		}
+		visited.emplace(hash, object);
+		stack.push_back(object);
+	};
+	visit(value);
+	while (!stack.empty()) {
+		Local<Object> object = stack.back();
+		stack.pop_back();
+		Unmaybe(object->SetIntegrityLevel(context, IntegrityLevel::kFrozen));
+		Local<Array> keys = Unmaybe(object->GetOwnPropertyNames(context));
+		for (uint32_t ii = 0; ii < keys->Length(); ++ii) {
+			visit(Unmaybe(object->Get(context, Unmaybe(keys->Get(context, ii)))));
+		}
+	}
+}
+
+/**
+ * ExternalCopyChunked implementation
+ */
+ExternalCopyChunked::ExternalCopyChunked(std::vector<unique_ptr<ExternalCopy>> chunks, uint32_t length, size_t size) :
+	ExternalCopy(size + sizeof(ExternalCopyChunked)),
+	chunks(std::move(chunks)),
+	length(length),
+	remaining_size(size + sizeof(ExternalCopyChunked)) {
+	// This instance is accounted for all the chunks
+	for (auto& chunk : this->chunks) {
+		chunk->UpdateSize(0);
+	}
+}
+
+unique_ptr<ExternalCopy> ExternalCopyChunked::Copy(Local<Array> array, size_t chunk_size) {
+	Isolate* isolate = Isolate::GetCurrent();
+	Local<Context> context = isolate->GetCurrentContext();
+	uint32_t length = array->Length();
+	std::vector<unique_ptr<ExternalCopy>> chunks;
+	size_t size = 0;
+	// The serialized size of an element isn't known up front so start small and then size each slice
+	// based on how large the last one turned out.
+	uint64_t batch = 64;
+	for (uint32_t offset = 0; offset < length;) {
+		HandleScope handle_scope(isolate);
+		auto count = static_cast<uint32_t>(std::min<uint64_t>(batch, length - offset));
+		Local<Array> slice = Array::New(isolate, count);
+		for (uint32_t ii = 0; ii < count; ++ii) {
+			Unmaybe(slice->Set(context, ii, Unmaybe(array->Get(context, offset + ii))));
+		}
+		chunks.emplace_back(ExternalCopy::Copy(slice));
+		size_t serialized_size = chunks.back()->OriginalSize();
+		size += serialized_size;
+		offset += count;
+		batch = std::max<uint64_t>(1, count * static_cast<uint64_t>(chunk_size) / std::max<size_t>(1, serialized_size));
+	}
+	return make_unique<ExternalCopyChunked>(std::move(chunks), length, size);
+}
+
+Local<Value> ExternalCopyChunked::CopyInto(bool transfer_in) {
+	Isolate* isolate = Isolate::GetCurrent();
+	Local<Context> context = isolate->GetCurrentContext();
+	auto allocator = dynamic_cast<LimitedAllocator*>(IsolateEnvironment::GetCurrent()->GetAllocator());
+	auto materialize = [&](std::vector<unique_ptr<ExternalCopy>>& slices) {
+		Local<Array> array = Array::New(isolate, length);
+		uint32_t offset = 0;
+		for (auto& chunk : slices) {
+			HandleScope handle_scope(isolate);
+			if (allocator != nullptr && !transfer_in && !allocator->Check(chunk->OriginalSize())) {
+				throw js_range_error("Copy would exceed isolate memory limit");
+			}
+			Local<Array> slice = chunk->CopyIntoCheckHeap(transfer_in).As<Array>();
+			uint32_t count = slice->Length();
+			for (uint32_t ii = 0; ii < count; ++ii) {
+				Unmaybe(array->Set(context, offset + ii, Unmaybe(slice->Get(context, ii))));
+			}
+			offset += count;
+			if (transfer_in) {
+				size_t freed = chunk->OriginalSize();
+				chunk.reset();
+				std::lock_guard<std::mutex> lock{mutex};
+				remaining_size -= freed;
+				UpdateSize(remaining_size);
+			}
+		}
+		return array;
+	};
+
+	if (!transfer_in) {
+		// Plain copies only read the slices but they must not overlap a transfer freeing them
+		std::lock_guard<std::mutex> lock{mutex};
+		if (transferred) {
+			throw js_generic_error("Copy has already been transferred in");
+		}
+		return materialize(chunks);
+	}
+
+	// A transfer takes the slices for itself so that it can free them without holding the lock.
+	// Give up with a RangeError before materializing anything which would put the isolate over its
+	// limit, instead of letting the heap check terminate the isolate afterwards. A transfer frees each
+	// slice as it goes, so the whole array is checked up front to make sure no slice is consumed by a
+	// transfer which then fails.
+	std::vector<unique_ptr<ExternalCopy>> taken;
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		if (transferred) {
+			throw js_generic_error("Copy has already been transferred in");
+		}
+		if (allocator != nullptr && !allocator->Check(remaining_size)) {
+			throw js_range_error("Copy would exceed isolate memory limit");
+		}
+		transferred = true;
+		taken.swap(chunks);
+	}
+	try {
+		return materialize(taken);
+	} catch (...) {
+		// Put back whatever is left. If a slice was already consumed the copy stays spent.
+		std::lock_guard<std::mutex> lock{mutex};
+		transferred = !taken.empty() && !taken.front();
+		chunks = std::move(taken);
+		throw;
+	}
+}
+
 /**
  * ExternalCopyError implementation
  */
@@ -474,6 +773,76 @@ Local<Value> ExternalCopyDate::CopyInto(bool /*transfer_in*/) {
 /**
  * ExternalCopyBytes implementation
  */
+std::atomic<size_t> ExternalCopyBytes::parallel_copy_threshold{16 * 1024 * 1024};
+
+namespace {
+/**
+ * State shared between the thread which requested a parallel copy and the pool workers helping out.
+ * Slices are claimed with an atomic counter, so the requesting thread only ever waits on slices which
+ * are already being copied. If the pool is busy it just ends up doing the whole copy by itself.
+ */
+struct ParallelCopy {
+	static constexpr size_t kSliceSize = 4 * 1024 * 1024;
+	char* dest;
+	const char* src;
+	size_t length;
+	size_t slices;
+	std::atomic<size_t> next{0};
+	size_t finished = 0;
+	std::mutex mutex;
+	std::condition_variable cv;
+
+	ParallelCopy(void* dest, const void* src, size_t length) :
+		dest{static_cast<char*>(dest)}, src{static_cast<const char*>(src)}, length{length},
+		slices{(length + kSliceSize - 1) / kSliceSize} {}
+
+	bool CopySlice() {
+		size_t slice = next++;
+		if (slice >= slices) {
+			return false;
+		}
+		size_t offset = slice * kSliceSize;
+		std::memcpy(dest + offset, src + offset, std::min(length - offset, size_t{kSliceSize}));
+		std::lock_guard<std::mutex> lock{mutex};
+		if (++finished == slices) {
+			cv.notify_one();
+		}
+		return true;
+	}
+
+	static void Entry(bool /* pool_thread */, void* param) {
+		std::unique_ptr<shared_ptr<ParallelCopy>> state{static_cast<shared_ptr<ParallelCopy>*>(param)};
+		while ((*state)->CopySlice()) {}
+	}
+};
+} // anonymous namespace
+
+void ExternalCopyBytes::CopyBytes(void* dest, const void* src, size_t length) {
+	size_t threshold = parallel_copy_threshold;
+	// Helpers are low priority pool tasks, so they only soak up threads which would otherwise be idle
+	size_t helpers = std::min<size_t>(
+		std::max(std::thread::hardware_concurrency(), 1U) - 1,
+		IsolateEnvironment::Scheduler::ThreadPoolSize()
+	);
+	if (threshold == 0 || length < threshold || length <= ParallelCopy::kSliceSize || helpers == 0) {
+		std::memcpy(dest, src, length);
+		return;
+	}
+	auto state = std::make_shared<ParallelCopy>(dest, src, length);
+	helpers = std::min(helpers, state->slices - 1);
+	static thread_pool_t::affinity_t affinity;
+	for (size_t ii = 0; ii < helpers; ++ii) {
+		IsolateEnvironment::Scheduler::RunInThreadPool(affinity, ParallelCopy::Entry, new shared_ptr<ParallelCopy>(state), true);
+	}
+	while (state->CopySlice()) {}
+	std::unique_lock<std::mutex> lock{state->mutex};
+	state->cv.wait(lock, [&]() { return state->finished == state->slices; });
+}
+
+void ExternalCopyBytes::SetParallelCopyThreshold(size_t threshold) {
+	parallel_copy_threshold = threshold;
+}
+
 ExternalCopyBytes::ExternalCopyBytes(size_t size, shared_ptr<void> value, size_t length) :
 		ExternalCopy{size}, value{std::move(value)}, length{length} {}
 
@@ -527,7 +896,7 @@ void ExternalCopyBytes::Holder::WeakCallback(void* param) {
  */
 ExternalCopyArrayBuffer::ExternalCopyArrayBuffer(const void* data, size_t length) :
 		ExternalCopyBytes{length + sizeof(ExternalCopyArrayBuffer), {malloc(length), std::free}, length} {
-	std::memcpy(Acquire().get(), data, length);
+	CopyBytes(Acquire().get(), data, length);
 }
 
 ExternalCopyArrayBuffer::ExternalCopyArrayBuffer(shared_ptr<void> ptr, size_t length) :
@@ -538,7 +907,62 @@ ExternalCopyArrayBuffer::ExternalCopyArrayBuffer(const Local<ArrayBuffer>& handl
 			handle->ByteLength() + sizeof(ExternalCopyArrayBuffer),
 			{malloc(handle->ByteLength()), std::free},
 			handle->ByteLength()} {
-	std::memcpy(Acquire().get(), handle->GetContents().Data(), Length());
+	CopyBytes(Acquire().get(), handle->GetContents().Data(), Length());
+}
+
+unique_ptr<ExternalCopyArrayBuffer> ExternalCopyArrayBuffer::FromFile(const char* path) {
+	auto fail = [&](const char* message) {
+		return js_generic_error(std::string(message)+ " '"+ path+ "': "+ std::strerror(errno));
+	};
+#ifdef _WIN32
+	// No mapping here, the file is just read into memory
+	struct _stat64 info;
+	if (_stat64(path, &info) != 0) {
+		throw fail("Failed to open");
+	}
+	auto length = static_cast<size_t>(info.st_size);
+	if (length == 0) {
+		throw js_generic_error(std::string("File '")+ path+ "' is empty");
+	}
+	std::unique_ptr<FILE, int(*)(FILE*)> file{std::fopen(path, "rb"), std::fclose};
+	if (!file) {
+		throw fail("Failed to open");
+	}
+	shared_ptr<void> data{std::malloc(length), std::free};
+	if (!data) {
+		throw js_range_error("Array buffer allocation failed");
+	}
+	if (std::fread(data.get(), 1, length, file.get()) != length) {
+		throw fail("Failed to read");
+	}
+#else
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		throw fail("Failed to open");
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		auto error = fail("Failed to stat");
+		close(fd);
+		throw error;
+	}
+	auto length = static_cast<size_t>(info.st_size);
+	if (length == 0) {
+		close(fd);
+		throw js_generic_error(std::string("File '")+ path+ "' is empty");
+	}
+	// The mapping is private and writable so it can be handed to v8 as a regular ArrayBuffer. Pages
+	// are only copied if an isolate writes to them, and the file itself is never modified.
+	void* address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (address == MAP_FAILED) {
+		auto error = fail("Failed to map");
+		close(fd);
+		throw error;
+	}
+	close(fd);
+	shared_ptr<void> data{address, [length](void* ptr) { munmap(ptr, length); }};
+#endif
+	return std::make_unique<ExternalCopyArrayBuffer>(std::move(data), length);
 }
 
 unique_ptr<ExternalCopyArrayBuffer> ExternalCopyArrayBuffer::Transfer(const Local<ArrayBuffer>& handle) {
@@ -560,11 +984,14 @@ unique_ptr<ExternalCopyArrayBuffer> ExternalCopyArrayBuffer::Transfer(const Loca
 	// In this case the buffer is internal and can be released easily
 	ArrayBuffer::Contents contents = handle->Externalize();
 	auto allocator = dynamic_cast<LimitedAllocator*>(IsolateEnvironment::GetCurrent()->GetAllocator());
-	if (allocator != nullptr) {
+	shared_ptr<void> data_ptr;
+	if (allocator == nullptr) {
+		data_ptr = shared_ptr<void>(contents.Data(), std::free);
+	} else {
 		allocator->AdjustAllocatedSize(-static_cast<ptrdiff_t>(length));
+		data_ptr = allocator->Adopt(contents.Data(), length);
 	}
 	assert(handle->IsNeuterable());
-	auto data_ptr = shared_ptr<void>(contents.Data(), std::free);
 	handle->Neuter();
 	return std::make_unique<ExternalCopyArrayBuffer>(std::move(data_ptr), length);
 }
@@ -592,11 +1019,20 @@ Local<Value> ExternalCopyArrayBuffer::CopyInto(bool transfer_in) {
 		}
 		auto ptr = Acquire();
 		Local<ArrayBuffer> array_buffer = ArrayBuffer::New(Isolate::GetCurrent(), Length());
-		std::memcpy(array_buffer->GetContents().Data(), ptr.get(), Length());
+		CopyBytes(array_buffer->GetContents().Data(), ptr.get(), Length());
 		return array_buffer;
 	}
 }
 
+Local<Value> ExternalCopyArrayBuffer::CopyIntoShared() {
+	auto ptr = Acquire();
+	Local<SharedArrayBuffer> array_buffer = SharedArrayBuffer::New(Isolate::GetCurrent(), ptr.get(), Length());
+	// The memory belongs to this copy and isn't counted against the isolate, no matter how many
+	// isolates it's shared with
+	new Holder{array_buffer, std::move(ptr), 0};
+	return array_buffer;
+}
+
 /**
  * ExternalCopySharedArrayBuffer implementation
  */
@@ -619,10 +1055,15 @@ ExternalCopySharedArrayBuffer::ExternalCopySharedArrayBuffer(const v8::Local<v8:
 			}
 			// In this case the buffer is internal and should be externalized
 			SharedArrayBuffer::Contents contents = handle->Externalize();
-			auto value = shared_ptr<void>{contents.Data(), std::free};
+			auto allocator = dynamic_cast<LimitedAllocator*>(IsolateEnvironment::GetCurrent()->GetAllocator());
+			shared_ptr<void> value;
+			if (allocator == nullptr) {
+				value = shared_ptr<void>{contents.Data(), std::free};
+			} else {
+				value = allocator->Adopt(contents.Data(), length);
+			}
 			new Holder{handle, value, length};
 			// Adjust allocator memory down, and `Holder` will adjust memory back up
-			auto allocator = dynamic_cast<LimitedAllocator*>(IsolateEnvironment::GetCurrent()->GetAllocator());
 			if (allocator != nullptr) {
 				allocator->AdjustAllocatedSize(-static_cast<ptrdiff_t>(length));
 			}
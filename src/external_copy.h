@@ -3,7 +3,11 @@
 #include <atomic>
 #include <cstdint>
 #include <cstdlib>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "transferable.h"
@@ -140,6 +144,7 @@ class ExternalCopyString : public ExternalCopy {
 				~ExternalString() final;
 				const uint16_t* data() const final;
 				size_t length() const final;
+				const std::shared_ptr<V>& shared() const { return value; }
 		};
 
 		class ExternalStringOneByte : public v8::String::ExternalOneByteStringResource {
@@ -153,14 +158,27 @@ class ExternalCopyString : public ExternalCopy {
 				~ExternalStringOneByte() final;
 				const char* data() const final;
 				size_t length() const final;
+				const std::shared_ptr<V>& shared() const { return value; }
 		};
 
+		// Every live ExternalString and ExternalStringOneByte. v8 will give us back the resource of an
+		// external string, but since the node binary has no RTTI this is the only way to find out
+		// whether or not we are the ones who made it.
+		static std::mutex resources_mutex;
+		static std::unordered_set<const v8::String::ExternalStringResourceBase*> resources;
+		static void RegisterResource(const v8::String::ExternalStringResourceBase* resource);
+		static void UnregisterResource(const v8::String::ExternalStringResourceBase* resource);
+		bool ShareExternal(v8::Local<v8::String> string);
+
 	public:
 		// gcc 5 doesn't want this to be explicit
 		ExternalCopyString(v8::Local<v8::String> string);
 		explicit ExternalCopyString(const char* message);
 		explicit ExternalCopyString(const std::string& message);
 		v8::Local<v8::Value> CopyInto(bool transfer_in = false) final;
+		// Raw contents, Latin-1 or UTF-16 depending on `IsOneByte()`
+		const std::vector<char>& Bytes() const { return *value; }
+		bool IsOneByte() const { return one_byte; }
 };
 
 /**
@@ -184,6 +202,85 @@ class ExternalCopySerialized : public ExternalCopy {
 		v8::Local<v8::Value> CopyInto(bool transfer_in = false) final;
 };
 
+/**
+ * Per-isolate cache of values materialized from `ExternalCopySerialized`, used by the `cache` copy
+ * option. Cached values are deeply frozen so they can be handed out repeatedly. There is one entry
+ * per copy and context. Entries for copies or contexts which are gone are swept out in batches, and
+ * the least recently used entries are evicted to keep the serialized size of everything cached under
+ * `budget`.
+ */
+class ExternalCopyCache {
+	private:
+		// Contexts are told apart by the identity hash of their global object, which isn't unique, so
+		// entries with the same key are compared against the context directly.
+		struct Key {
+			const ExternalCopy* copy;
+			int context_hash;
+			bool operator==(const Key& that) const {
+				return copy == that.copy && context_hash == that.context_hash;
+			}
+		};
+		struct KeyHash {
+			size_t operator()(const Key& key) const {
+				return std::hash<const ExternalCopy*>{}(key.copy) ^ std::hash<int>{}(key.context_hash);
+			}
+		};
+		struct Entry;
+		using lru_list_t = std::list<std::pair<Key, Entry*>>;
+		// The context is held weakly and the value hangs off its global object under `key`, so the cache
+		// never keeps a context alive. Entries for collected contexts are dropped by the next sweep.
+		struct Entry {
+			ExternalCopyCache* cache;
+			std::weak_ptr<ExternalCopy> copy;
+			v8::Global<v8::Context> context;
+			v8::Global<v8::Private> key;
+			size_t size;
+			lru_list_t::iterator lru;
+		};
+		using entry_map_t = std::unordered_multimap<Key, Entry, KeyHash>;
+		static constexpr size_t kMinimumSweep = 64;
+
+		size_t budget;
+		size_t size = 0;
+		// Entries are swept for destroyed copies and contexts when there are this many of them
+		size_t sweep_at = kMinimumSweep;
+		lru_list_t lru;
+		entry_map_t entries;
+
+		entry_map_t::iterator Find(const lru_list_t::value_type& item);
+		void Evict(entry_map_t::iterator it);
+		void Sweep();
+		static void WeakCallbackV8(const v8::WeakCallbackInfo<Entry>& info);
+		static void Freeze(v8::Local<v8::Context> context, v8::Local<v8::Value> value);
+
+	public:
+		explicit ExternalCopyCache(size_t budget);
+		ExternalCopyCache(const ExternalCopyCache&) = delete;
+		ExternalCopyCache& operator= (const ExternalCopyCache&) = delete;
+		// Returns true if `copy` would be cached by `CopyInto`
+		static bool IsCacheable(const ExternalCopy& copy);
+		v8::Local<v8::Value> CopyInto(const std::shared_ptr<ExternalCopy>& copy);
+};
+
+/**
+ * Large arrays copied as a sequence of independently serialized slices. This keeps the serializer's
+ * scratch buffer small, and when the copy is transferred in each slice is freed as soon as it has
+ * been materialized.
+ */
+class ExternalCopyChunked : public ExternalCopy {
+	private:
+		std::vector<std::unique_ptr<ExternalCopy>> chunks;
+		uint32_t length;
+		size_t remaining_size;
+		bool transferred = false;
+		std::mutex mutex;
+
+	public:
+		ExternalCopyChunked(std::vector<std::unique_ptr<ExternalCopy>> chunks, uint32_t length, size_t size);
+		static std::unique_ptr<ExternalCopy> Copy(v8::Local<v8::Array> array, size_t chunk_size);
+		v8::Local<v8::Value> CopyInto(bool transfer_in = false) final;
+};
+
 /**
  * Make a special case for errors so if someone throws then a similar error will come out the other
  * side.
@@ -263,12 +360,18 @@ class ExternalCopyBytes : public ExternalCopy {
 		std::shared_ptr<void> Release();
 		void Replace(std::shared_ptr<void> value);
 
+		// `memcpy` which splits large copies across the thread pool
+		static void CopyBytes(void* dest, const void* src, size_t length);
+
 	public:
 		explicit ExternalCopyBytes(size_t size, std::shared_ptr<void> value, size_t length);
 		std::shared_ptr<void> Acquire() const;
 		size_t Length() { return length; }
+		// Copies of at least this many bytes are done in parallel. 0 disables parallel copies.
+		static void SetParallelCopyThreshold(size_t threshold);
 
 	private:
+		static std::atomic<size_t> parallel_copy_threshold;
 		std::shared_ptr<void> value;
 		const size_t length;
 		mutable std::mutex mutex;
@@ -284,7 +387,11 @@ class ExternalCopyArrayBuffer : public ExternalCopyBytes {
 		explicit ExternalCopyArrayBuffer(const v8::Local<v8::ArrayBuffer>& handle);
 
 		static std::unique_ptr<ExternalCopyArrayBuffer> Transfer(const v8::Local<v8::ArrayBuffer>& handle);
+		// Maps a file into memory. Pages are shared with the OS page cache until they're written to.
+		static std::unique_ptr<ExternalCopyArrayBuffer> FromFile(const char* path);
 		v8::Local<v8::Value> CopyInto(bool transfer_in = false) final;
+		// Returns a SharedArrayBuffer backed by this copy's memory instead of copying it
+		v8::Local<v8::Value> CopyIntoShared();
 };
 
 /**
@@ -1,5 +1,8 @@
 #include "external_copy_handle.h"
 #include "external_copy.h"
+#include "isolate/environment.h"
+#include <algorithm>
+#include <limits>
 
 using namespace v8;
 using std::shared_ptr;
@@ -7,6 +10,38 @@ using std::unique_ptr;
 
 namespace ivm {
 
+namespace {
+/**
+ * Checks that a copy can be used with the `shared` option
+ */
+void CheckShareable(const shared_ptr<ExternalCopy>& value, bool transfer_in) {
+	if (transfer_in) {
+		throw js_type_error("`shared` can not be used with `transferIn`");
+	} else if (dynamic_cast<ExternalCopyArrayBuffer*>(value.get()) == nullptr) {
+		throw js_type_error("`shared` is only supported for copies of an ArrayBuffer");
+	}
+}
+
+/**
+ * Checks options for the `cache` option
+ */
+void CheckCacheable(bool transfer_in, bool shared) {
+	if (transfer_in || shared) {
+		throw js_type_error("`cache` can not be used with `transferIn` or `shared`");
+	}
+}
+
+Local<Value> CopyIntoWithOptions(const shared_ptr<ExternalCopy>& value, bool transfer_in, bool shared, bool cache) {
+	if (shared) {
+		return static_cast<ExternalCopyArrayBuffer*>(value.get())->CopyIntoShared();
+	} else if (cache && ExternalCopyCache::IsCacheable(*value)) {
+		return IsolateEnvironment::GetCurrent()->GetCopyCache().CopyInto(value);
+	} else {
+		return value->CopyIntoCheckHeap(transfer_in);
+	}
+}
+} // anonymous namespace
+
 /**
  * Transferable wrapper
  */
@@ -33,6 +68,8 @@ Local<FunctionTemplate> ExternalCopyHandle::Definition() {
 	return Inherit<TransferableHandle>(MakeClass(
 		"ExternalCopy", ParameterizeCtor<decltype(&New), &New>(),
 		"totalExternalSize", ParameterizeStaticAccessor<decltype(&ExternalCopyHandle::TotalExternalSizeGetter), &ExternalCopyHandle::TotalExternalSizeGetter>(),
+		"fromFile", ParameterizeStatic<decltype(&ExternalCopyHandle::FromFile), &ExternalCopyHandle::FromFile>(),
+		"setParallelCopyThreshold", ParameterizeStatic<decltype(&ExternalCopyHandle::SetParallelCopyThreshold), &ExternalCopyHandle::SetParallelCopyThreshold>(),
 		"copy", Parameterize<decltype(&ExternalCopyHandle::Copy), &ExternalCopyHandle::Copy>(),
 		"copyInto", Parameterize<decltype(&ExternalCopyHandle::CopyInto), &ExternalCopyHandle::CopyInto>(),
 		"release", Parameterize<decltype(&ExternalCopyHandle::Release), &ExternalCopyHandle::Release>()
@@ -47,9 +84,21 @@ unique_ptr<ExternalCopyHandle> ExternalCopyHandle::New(Local<Value> value, Maybe
 	Local<Context> context = Isolate::GetCurrent()->GetCurrentContext();
 	Local<Object> options;
 	bool transfer_out = false;
+	size_t chunk_size = 0;
 	handle_vector_t transfer_list;
 	if (maybe_options.ToLocal(&options)) {
 		transfer_out = IsOptionSet(Isolate::GetCurrent()->GetCurrentContext(), options, "transferOut");
+		Local<Value> chunk_size_handle = Unmaybe(options->Get(context, v8_string("chunkSize")));
+		if (!chunk_size_handle->IsUndefined()) {
+			if (!chunk_size_handle->IsNumber()) {
+				throw js_type_error("`chunkSize` must be a number");
+			}
+			double chunk_size_value = chunk_size_handle.As<Number>()->Value();
+			if (!(chunk_size_value >= 1)) {
+				throw js_range_error("`chunkSize` must be at least 1");
+			}
+			chunk_size = static_cast<size_t>(std::min<double>(chunk_size_value, std::numeric_limits<uint32_t>::max()));
+		}
 		Local<Value> transfer_list_handle = Unmaybe(options->Get(context, v8_string("transferList")));
 		if (!transfer_list_handle->IsUndefined()) {
 			if (!transfer_list_handle->IsArray()) {
@@ -62,6 +111,12 @@ unique_ptr<ExternalCopyHandle> ExternalCopyHandle::New(Local<Value> value, Maybe
 			}
 		}
 	}
+	if (chunk_size != 0 && value->IsArray()) {
+		if (!transfer_list.empty()) {
+			throw js_type_error("`chunkSize` can not be used with `transferList`");
+		}
+		return std::make_unique<ExternalCopyHandle>(shared_ptr<ExternalCopy>(ExternalCopyChunked::Copy(value.As<Array>(), chunk_size)));
+	}
 	return std::make_unique<ExternalCopyHandle>(shared_ptr<ExternalCopy>(ExternalCopy::Copy(value, transfer_out, transfer_list)));
 }
 
@@ -78,17 +133,44 @@ Local<Value> ExternalCopyHandle::TotalExternalSizeGetter() {
 	return Number::New(Isolate::GetCurrent(), ExternalCopy::TotalExternalSize());
 }
 
+Local<Value> ExternalCopyHandle::FromFile(Local<String> path) {
+	shared_ptr<ExternalCopy> value = ExternalCopyArrayBuffer::FromFile(*String::Utf8Value{Isolate::GetCurrent(), path});
+	return ClassHandle::NewInstance<ExternalCopyHandle>(std::move(value));
+}
+
+Local<Value> ExternalCopyHandle::SetParallelCopyThreshold(Local<Value> threshold_handle) {
+	if (!threshold_handle->IsNumber()) {
+		throw js_type_error("`threshold` must be a number");
+	}
+	double threshold = threshold_handle.As<Number>()->Value();
+	if (!(threshold >= 0)) {
+		throw js_range_error("`threshold` must not be negative");
+	}
+	// Anything past 2^53 may as well be infinite
+	ExternalCopyBytes::SetParallelCopyThreshold(threshold >= 9007199254740992.0 ? std::numeric_limits<size_t>::max() : static_cast<size_t>(threshold));
+	return Undefined(Isolate::GetCurrent());
+}
+
 Local<Value> ExternalCopyHandle::Copy(MaybeLocal<Object> maybe_options) {
 	CheckDisposed();
 	Local<Object> options;
 	bool release = false;
 	bool transfer_in = false;
+	bool shared = false;
+	bool cache = false;
 	if (maybe_options.ToLocal(&options)) {
 		Local<Context> context = Isolate::GetCurrent()->GetCurrentContext();
 		release = IsOptionSet(context, options, "release");
 		transfer_in = IsOptionSet(context, options, "transferIn");
+		shared = IsOptionSet(context, options, "shared");
+		cache = IsOptionSet(context, options, "cache");
+	}
+	if (cache) {
+		CheckCacheable(transfer_in, shared);
+	} else if (shared) {
+		CheckShareable(value, transfer_in);
 	}
-	Local<Value> ret = value->CopyIntoCheckHeap(transfer_in);
+	Local<Value> ret = CopyIntoWithOptions(value, transfer_in, shared, cache);
 	if (release) {
 		Release();
 	}
@@ -100,12 +182,21 @@ Local<Value> ExternalCopyHandle::CopyInto(MaybeLocal<Object> maybe_options) {
 	Local<Object> options;
 	bool release = false;
 	bool transfer_in = false;
+	bool shared = false;
+	bool cache = false;
 	if (maybe_options.ToLocal(&options)) {
 		Local<Context> context = Isolate::GetCurrent()->GetCurrentContext();
 		release = IsOptionSet(context, options, "release");
 		transfer_in = IsOptionSet(context, options, "transferIn");
+		shared = IsOptionSet(context, options, "shared");
+		cache = IsOptionSet(context, options, "cache");
+	}
+	if (cache) {
+		CheckCacheable(transfer_in, shared);
+	} else if (shared) {
+		CheckShareable(value, transfer_in);
 	}
-	Local<Value> ret = ClassHandle::NewInstance<ExternalCopyIntoHandle>(value, transfer_in);
+	Local<Value> ret = ClassHandle::NewInstance<ExternalCopyIntoHandle>(value, transfer_in, shared, cache);
 	if (release) {
 		Release();
 	}
@@ -122,13 +213,15 @@ Local<Value> ExternalCopyHandle::Release() {
 /**
  * ExternalCopyIntoHandle implementation
  */
-ExternalCopyIntoHandle::ExternalCopyIntoTransferable::ExternalCopyIntoTransferable(shared_ptr<ExternalCopy> value, bool transfer_in) : value(std::move(value)), transfer_in(transfer_in) {}
+ExternalCopyIntoHandle::ExternalCopyIntoTransferable::ExternalCopyIntoTransferable(shared_ptr<ExternalCopy> value, bool transfer_in, bool shared, bool cache) :
+	value(std::move(value)), transfer_in(transfer_in), shared(shared), cache(cache) {}
 
 Local<Value> ExternalCopyIntoHandle::ExternalCopyIntoTransferable::TransferIn() {
-	return value->CopyIntoCheckHeap(transfer_in);
+	return CopyIntoWithOptions(value, transfer_in, shared, cache);
 }
 
-ExternalCopyIntoHandle::ExternalCopyIntoHandle(shared_ptr<ExternalCopy> value, bool transfer_in) : value(std::move(value)), transfer_in(transfer_in) {}
+ExternalCopyIntoHandle::ExternalCopyIntoHandle(shared_ptr<ExternalCopy> value, bool transfer_in, bool shared, bool cache) :
+	value(std::move(value)), transfer_in(transfer_in), shared(shared), cache(cache) {}
 
 Local<FunctionTemplate> ExternalCopyIntoHandle::Definition() {
 	return Inherit<TransferableHandle>(MakeClass("ExternalCopyInto", nullptr));
@@ -138,7 +231,7 @@ unique_ptr<Transferable> ExternalCopyIntoHandle::TransferOut() {
 	if (!value) {
 		throw js_generic_error("The return value of `copyInto()` should only be used once");
 	}
-	return std::make_unique<ExternalCopyIntoTransferable>(std::move(value), transfer_in);
+	return std::make_unique<ExternalCopyIntoTransferable>(std::move(value), transfer_in, shared, cache);
 }
 
 } // namespace ivm
@@ -32,6 +32,8 @@ class ExternalCopyHandle : public TransferableHandle {
 
 		static std::unique_ptr<ExternalCopyHandle> New(v8::Local<v8::Value> value, v8::MaybeLocal<v8::Object> maybe_options);
 		static v8::Local<v8::Value> TotalExternalSizeGetter();
+		static v8::Local<v8::Value> FromFile(v8::Local<v8::String> path);
+		static v8::Local<v8::Value> SetParallelCopyThreshold(v8::Local<v8::Value> threshold_handle);
 		v8::Local<v8::Value> Copy(v8::MaybeLocal<v8::Object> maybe_options);
 		v8::Local<v8::Value> CopyInto(v8::MaybeLocal<v8::Object> maybe_options);
 		v8::Local<v8::Value> Release();
@@ -44,17 +46,21 @@ class ExternalCopyIntoHandle : public TransferableHandle {
 			private:
 				std::shared_ptr<ExternalCopy> value;
 				bool transfer_in;
+				bool shared;
+				bool cache;
 
 			public:
-				explicit ExternalCopyIntoTransferable(std::shared_ptr<ExternalCopy> value, bool transfer_in);
+				explicit ExternalCopyIntoTransferable(std::shared_ptr<ExternalCopy> value, bool transfer_in, bool shared, bool cache);
 				v8::Local<v8::Value> TransferIn() final;
 		};
 
 		std::shared_ptr<ExternalCopy> value;
 		bool transfer_in;
+		bool shared;
+		bool cache;
 
 	public:
-		explicit ExternalCopyIntoHandle(std::shared_ptr<ExternalCopy> value, bool transfer_in);
+		explicit ExternalCopyIntoHandle(std::shared_ptr<ExternalCopy> value, bool transfer_in, bool shared, bool cache);
 		static v8::Local<v8::FunctionTemplate> Definition();
 		std::unique_ptr<Transferable> TransferOut() final;
 };
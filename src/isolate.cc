@@ -9,6 +9,7 @@
 #include "native_module_handle.h"
 #include "reference_handle.h"
 #include "script_handle.h"
+#include "script_template_handle.h"
 
 #include <memory>
 
@@ -37,7 +38,8 @@ class LibraryHandle : public TransferableHandle {
 				"Isolate", ClassHandle::GetFunctionTemplate<IsolateHandle>(),
 				"NativeModule", ClassHandle::GetFunctionTemplate<NativeModuleHandle>(),
 				"Reference", ClassHandle::GetFunctionTemplate<ReferenceHandle>(),
-				"Script", ClassHandle::GetFunctionTemplate<ScriptHandle>()
+				"Script", ClassHandle::GetFunctionTemplate<ScriptHandle>(),
+				"ScriptTemplate", ClassHandle::GetFunctionTemplate<ScriptTemplateHandle>()
 			));
 		}
 
@@ -1,42 +1,48 @@
 #include "allocator.h"
 #include "environment.h"
 #include <cstdlib>
+#include <cstring>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 using namespace v8;
 
 namespace ivm {
 
+namespace {
+// Buffers at least this big are mapped directly. The kernel hands out zeroed pages on first touch
+// so large buffers don't need to be cleared up front, and unmapping returns them immediately.
+constexpr size_t kMapThreshold = 256 * 1024;
+} // anonymous namespace
+
 /**
  * ArrayBuffer::Allocator that enforces memory limits. The v8 documentation specifically says
  * that it's unsafe to call back into v8 from this class but I took a look at
  * GetHeapStatistics() and I think it'll be ok.
  */
 bool LimitedAllocator::Check(const size_t length) {
-	if (v8_heap + env.extra_allocated_memory + length > next_check) {
-		HeapStatistics heap_statistics;
-		Isolate* isolate = Isolate::GetCurrent();
-		isolate->GetHeapStatistics(&heap_statistics);
-		v8_heap = heap_statistics.used_heap_size();
-		if (v8_heap + env.extra_allocated_memory + length > limit + env.misc_memory_size) {
-			// This is might be dangerous but the tests pass soooo..
-			isolate->LowMemoryNotification();
-			isolate->GetHeapStatistics(&heap_statistics);
-			v8_heap = heap_statistics.used_heap_size();
-			if (v8_heap + env.extra_allocated_memory + length > limit + env.misc_memory_size) {
-				return false;
-			}
-		}
-		next_check = v8_heap + env.extra_allocated_memory + length + 1024 * 1024;
+	// Usually this is just a comparison against the heap size from the last collection. The heap is
+	// only measured, and a full collection forced, when that says the allocation won't fit.
+	size_t total_limit = limit + env.misc_memory_size;
+	if (!env.IsOverMemoryLimit(length, total_limit)) {
+		return true;
 	}
-	return v8_heap + env.extra_allocated_memory + length <= limit + env.misc_memory_size;
+	env.RefreshHeapSize();
+	if (env.IsOverMemoryLimit(length, total_limit)) {
+		// This is might be dangerous but the tests pass soooo..
+		Isolate::GetCurrent()->LowMemoryNotification();
+		env.RefreshHeapSize();
+	}
+	return !env.IsOverMemoryLimit(length, total_limit);
 }
 
-LimitedAllocator::LimitedAllocator(IsolateEnvironment& env, size_t limit) : env(env), limit(limit), v8_heap(1024 * 1024 * 4), next_check(1024 * 1024) {}
+LimitedAllocator::LimitedAllocator(IsolateEnvironment& env, size_t limit) : env(env), limit(limit) {}
 
 void* LimitedAllocator::Allocate(size_t length) {
 	if (Check(length)) {
 		env.extra_allocated_memory += length;
-		return std::calloc(length, 1);
+		return AllocateRaw(length, true);
 	} else {
 		++failures;
 		if (length <= 64) { // kMinAddedElementsCapacity * sizeof(uint32_t)
@@ -48,7 +54,7 @@ void* LimitedAllocator::Allocate(size_t length) {
 			// and will soon be freed because at the same time we terminate the isolate.
 			env.extra_allocated_memory += length;
 			env.Terminate();
-			return std::calloc(length, 1);
+			return AllocateRaw(length, true);
 		} else {
 			// The places end up here are more graceful and will throw a RangeError
 			return nullptr;
@@ -59,13 +65,13 @@ void* LimitedAllocator::Allocate(size_t length) {
 void* LimitedAllocator::AllocateUninitialized(size_t length) {
 	if (Check(length)) {
 		env.extra_allocated_memory += length;
-		return std::malloc(length);
+		return AllocateRaw(length, false);
 	} else {
 		++failures;
 		if (length <= 64) {
 			env.extra_allocated_memory += length;
 			env.Terminate();
-			return std::malloc(length);
+			return AllocateRaw(length, false);
 		} else {
 			return nullptr;
 		}
@@ -74,8 +80,46 @@ void* LimitedAllocator::AllocateUninitialized(size_t length) {
 
 void LimitedAllocator::Free(void* data, size_t length) {
 	env.extra_allocated_memory -= length;
-	next_check -= length;
-	std::free(data);
+	FreeRaw(pool.get(), data, length);
+}
+
+void* LimitedAllocator::AllocateRaw(size_t length, bool zero) {
+	if (length <= slab_pool_t::kMaxSize) {
+		void* data = pool->allocate(length);
+		if (zero && data != nullptr) {
+			std::memset(data, 0, length);
+		}
+		return data;
+	}
+#ifndef _WIN32
+	if (length >= kMapThreshold) {
+		void* data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		return data == MAP_FAILED ? nullptr : data;
+	}
+#endif
+	return zero ? std::calloc(length, 1) : std::malloc(length);
+}
+
+void LimitedAllocator::FreeRaw(slab_pool_t* pool, void* data, size_t length) {
+	if (data == nullptr) {
+		return;
+	} else if (length <= slab_pool_t::kMaxSize) {
+		pool->free(data, length);
+#ifndef _WIN32
+	} else if (length >= kMapThreshold) {
+		munmap(data, length);
+#endif
+	} else {
+		std::free(data);
+	}
+}
+
+std::shared_ptr<void> LimitedAllocator::Adopt(void* data, size_t length) {
+	// The deleter holds a reference to the pool, so small blocks stay valid after the isolate is
+	// disposed. The pool's chunks are released in bulk once the last of these is gone.
+	return std::shared_ptr<void>(data, [pool = pool, length](void* ptr) {
+		FreeRaw(pool.get(), ptr, length);
+	});
 }
 
 void LimitedAllocator::AdjustAllocatedSize(ptrdiff_t length) {
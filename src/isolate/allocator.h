@@ -1,5 +1,7 @@
 #pragma once
 #include <v8.h>
+#include "../slab_pool.h"
+#include <memory>
 
 namespace ivm {
 
@@ -7,10 +9,12 @@ class LimitedAllocator : public v8::ArrayBuffer::Allocator {
 	private:
 		class IsolateEnvironment& env;
 		size_t limit;
-		size_t v8_heap;
-		size_t next_check;
 		int failures = 0;
+		// Shared with buffers that are externalized so that blocks can outlive the isolate
+		std::shared_ptr<slab_pool_t> pool = std::make_shared<slab_pool_t>();
 
+		void* AllocateRaw(size_t length, bool zero);
+		static void FreeRaw(slab_pool_t* pool, void* data, size_t length);
 
 	public:
 		bool Check(size_t length);
@@ -21,6 +25,8 @@ class LimitedAllocator : public v8::ArrayBuffer::Allocator {
 		// This is used by ExternalCopy when an ArrayBuffer is transferred. The memory is not freed but
 		// we should no longer count it against the isolate
 		void AdjustAllocatedSize(ptrdiff_t length);
+		// Takes ownership of memory released from an ArrayBuffer by `Externalize()`
+		std::shared_ptr<void> Adopt(void* data, size_t length);
 		int GetFailureCount() const;
 };
 
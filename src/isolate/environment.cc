@@ -7,10 +7,6 @@
 #include <algorithm>
 #include <cmath>
 
-#ifdef USE_CLOCK_THREAD_CPUTIME_ID
-#include <time.h>
-#endif
-
 #ifdef __APPLE__
 #include <pthread.h>
 static void* GetStackBase() {
@@ -59,6 +55,11 @@ IsolateEnvironment::Executor::Unlock::Unlock(IsolateEnvironment& env) : pause_sc
 IsolateEnvironment::Executor::Unlock::~Unlock() = default;
 
 IsolateEnvironment::Executor::CpuTimer::CpuTimer(Executor& executor) : executor{executor}, last{Executor::cpu_timer_thread}, time{Now()} {
+#if USE_CLOCK_THREAD_CPUTIME_ID
+	if (pthread_getcpuclockid(pthread_self(), &clock_id) != 0) {
+		clock_id = CLOCK_THREAD_CPUTIME_ID;
+	}
+#endif
 	Executor::cpu_timer_thread = this;
 	std::lock_guard<std::mutex> lock(executor.timer_mutex);
 	assert(executor.cpu_timer == nullptr);
@@ -74,7 +75,12 @@ IsolateEnvironment::Executor::CpuTimer::~CpuTimer() {
 }
 
 std::chrono::nanoseconds IsolateEnvironment::Executor::CpuTimer::Delta(const std::lock_guard<std::mutex>& /* lock */) const {
+#if USE_CLOCK_THREAD_CPUTIME_ID
+	// This may be called from any thread so read the owning thread's clock
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Now(clock_id) - time);
+#else
 	return std::chrono::duration_cast<std::chrono::nanoseconds>(Now() - time);
+#endif
 }
 
 void IsolateEnvironment::Executor::CpuTimer::Pause() {
@@ -95,8 +101,12 @@ void IsolateEnvironment::Executor::CpuTimer::Resume() {
 
 #if USE_CLOCK_THREAD_CPUTIME_ID
 IsolateEnvironment::Executor::CpuTimer::TimePoint IsolateEnvironment::Executor::CpuTimer::Now() {
+	return Now(CLOCK_THREAD_CPUTIME_ID);
+}
+
+IsolateEnvironment::Executor::CpuTimer::TimePoint IsolateEnvironment::Executor::CpuTimer::Now(clockid_t clock_id) {
 	timespec ts;
-	assert(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0);
+	assert(clock_gettime(clock_id, &ts) == 0);
 	return TimePoint{std::chrono::duration_cast<std::chrono::system_clock::duration>(
 		std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)
 	)};
@@ -179,6 +189,8 @@ IsolateEnvironment::Executor::Scope::~Scope() {
 IsolateEnvironment::Scheduler* IsolateEnvironment::Scheduler::default_scheduler;
 uv_async_t IsolateEnvironment::Scheduler::root_async;
 thread_pool_t IsolateEnvironment::Scheduler::thread_pool(std::thread::hardware_concurrency() + 1);
+std::mutex IsolateEnvironment::Scheduler::thread_pool_groups_mutex;
+std::unordered_map<std::string, unique_ptr<thread_pool_t>> IsolateEnvironment::Scheduler::thread_pool_groups;
 std::atomic<unsigned int> IsolateEnvironment::Scheduler::uv_ref_count(0);
 
 IsolateEnvironment::Scheduler::Scheduler() = default;
@@ -219,6 +231,34 @@ void IsolateEnvironment::Scheduler::DecrementUvRef() {
 	}
 }
 
+void IsolateEnvironment::Scheduler::SetThreadPoolSize(size_t size, const std::string& group) {
+	if (group.empty()) {
+		thread_pool.resize(size);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(thread_pool_groups_mutex);
+	auto& pool = thread_pool_groups[group];
+	if (pool) {
+		pool->resize(size);
+	} else {
+		pool = std::make_unique<thread_pool_t>(size);
+	}
+}
+
+thread_pool_t* IsolateEnvironment::Scheduler::GetThreadPoolGroup(const std::string& group) {
+	std::lock_guard<std::mutex> lock(thread_pool_groups_mutex);
+	auto ii = thread_pool_groups.find(group);
+	return ii == thread_pool_groups.end() ? nullptr : ii->second.get();
+}
+
+void IsolateEnvironment::Scheduler::RunInThreadPool(thread_pool_t::affinity_t& affinity, thread_pool_t::entry_t* entry, void* param, bool low_priority) {
+	thread_pool.exec(affinity, entry, param, low_priority);
+}
+
+size_t IsolateEnvironment::Scheduler::ThreadPoolSize() {
+	return thread_pool.size();
+}
+
 void IsolateEnvironment::Scheduler::AsyncCallbackNonDefaultIsolate(bool pool_thread, void* param) {
 	AsyncCallbackCommon(pool_thread, param);
 	if (--uv_ref_count == 0) {
@@ -251,76 +291,76 @@ void IsolateEnvironment::Scheduler::AsyncCallbackDefaultIsolate(uv_async_t* asyn
 
 void IsolateEnvironment::Scheduler::AsyncCallbackInterrupt(Isolate* /* isolate_ptr */, void* env_ptr) {
 	IsolateEnvironment& env = *static_cast<IsolateEnvironment*>(env_ptr);
-	env.InterruptEntry<&Lock::TakeInterrupts>();
+	env.InterruptEntry<&Scheduler::TakeInterrupts>();
 }
 
 void IsolateEnvironment::Scheduler::SyncCallbackInterrupt(Isolate* /* isolate_ptr */, void* env_ptr) {
 	IsolateEnvironment& env = *static_cast<IsolateEnvironment*>(env_ptr);
-	env.InterruptEntry<&Lock::TakeSyncInterrupts>();
+	env.InterruptEntry<&Scheduler::TakeSyncInterrupts>();
 }
 
 IsolateEnvironment::Scheduler::Lock::Lock(Scheduler& scheduler) : scheduler(scheduler), lock(scheduler.mutex) {}
 IsolateEnvironment::Scheduler::Lock::~Lock() = default;
 
-void IsolateEnvironment::Scheduler::Lock::DoneRunning() {
-	assert(scheduler.status == Status::Running);
-	scheduler.status = Status::Waiting;
+bool IsolateEnvironment::Scheduler::DoneRunning() {
+	assert(status == Status::Running);
+	status = Status::Waiting;
+	// A task could have been pushed after the caller's last check but before the `Waiting` status
+	// was visible to `WakeIsolate`. In that case take the isolate back, unless another thread beat us
+	// to it and already scheduled a wake.
+	if (tasks.empty() && handle_tasks.empty() && interrupts.empty()) {
+		return true;
+	}
+	Status expected = Status::Waiting;
+	return !status.compare_exchange_strong(expected, Status::Running);
 }
 
-void IsolateEnvironment::Scheduler::Lock::PushTask(unique_ptr<Runnable> task) {
-	scheduler.tasks.push(std::move(task));
+void IsolateEnvironment::Scheduler::PushTask(unique_ptr<Runnable> task) {
+	tasks.push(std::move(task));
 }
 
-void IsolateEnvironment::Scheduler::Lock::PushHandleTask(unique_ptr<Runnable> handle_task) {
-	scheduler.handle_tasks.push(std::move(handle_task));
+void IsolateEnvironment::Scheduler::PushHandleTask(unique_ptr<Runnable> handle_task) {
+	handle_tasks.push(std::move(handle_task));
 }
 
-void IsolateEnvironment::Scheduler::Lock::PushInterrupt(unique_ptr<Runnable> interrupt) {
-	scheduler.interrupts.push(std::move(interrupt));
+void IsolateEnvironment::Scheduler::PushInterrupt(unique_ptr<Runnable> interrupt) {
+	interrupts.push(std::move(interrupt));
 }
 
-void IsolateEnvironment::Scheduler::Lock::PushSyncInterrupt(unique_ptr<Runnable> interrupt) {
-	scheduler.sync_interrupts.push(std::move(interrupt));
+void IsolateEnvironment::Scheduler::PushSyncInterrupt(unique_ptr<Runnable> interrupt) {
+	sync_interrupts.push(std::move(interrupt));
 }
 
-std::queue<unique_ptr<Runnable>> IsolateEnvironment::Scheduler::Lock::TakeTasks() {
-	decltype(scheduler.tasks) tmp;
-	std::swap(tmp, scheduler.tasks);
-	return tmp;
+IsolateEnvironment::Scheduler::TaskList IsolateEnvironment::Scheduler::TakeTasks() {
+	return tasks.take();
 }
 
-std::queue<unique_ptr<Runnable>> IsolateEnvironment::Scheduler::Lock::TakeHandleTasks() {
-	decltype(scheduler.handle_tasks) tmp;
-	std::swap(tmp, scheduler.handle_tasks);
-	return tmp;
+IsolateEnvironment::Scheduler::TaskList IsolateEnvironment::Scheduler::TakeHandleTasks() {
+	return handle_tasks.take();
 }
 
-std::queue<unique_ptr<Runnable>> IsolateEnvironment::Scheduler::Lock::TakeInterrupts() {
-	decltype(scheduler.interrupts) tmp;
-	std::swap(tmp, scheduler.interrupts);
-	return tmp;
+IsolateEnvironment::Scheduler::TaskList IsolateEnvironment::Scheduler::TakeInterrupts() {
+	return interrupts.take();
 }
 
-std::queue<unique_ptr<Runnable>> IsolateEnvironment::Scheduler::Lock::TakeSyncInterrupts() {
-	decltype(scheduler.sync_interrupts) tmp;
-	std::swap(tmp, scheduler.sync_interrupts);
-	return tmp;
+IsolateEnvironment::Scheduler::TaskList IsolateEnvironment::Scheduler::TakeSyncInterrupts() {
+	return sync_interrupts.take();
 }
 
-bool IsolateEnvironment::Scheduler::Lock::WakeIsolate(shared_ptr<IsolateEnvironment> isolate_ptr) {
-	if (scheduler.status == Status::Waiting) {
-		scheduler.status = Status::Running;
-		IsolateEnvironment& isolate = *isolate_ptr;
-		// Grab shared reference to this which will be passed to the worker entry. This ensures the
-		// IsolateEnvironment won't be deleted before a thread picks up this work.
-		auto isolate_ptr_ptr = new shared_ptr<IsolateEnvironment>(std::move(isolate_ptr));
+bool IsolateEnvironment::Scheduler::WakeIsolate(shared_ptr<IsolateEnvironment> isolate_ptr) {
+	Status expected = Status::Waiting;
+	if (status.compare_exchange_strong(expected, Status::Running)) {
 		IncrementUvRef();
-		if (isolate.root) {
+		if (isolate_ptr->root) {
+			// Grab shared reference to this which will be passed to the worker entry. This ensures the
+			// IsolateEnvironment won't be deleted before a thread picks up this work.
+			auto isolate_ptr_ptr = new shared_ptr<IsolateEnvironment>(std::move(isolate_ptr));
+			Lock lock(*this);
 			assert(root_async.data == nullptr);
 			root_async.data = isolate_ptr_ptr;
 			uv_async_send(&root_async);
 		} else {
-			thread_pool.exec(scheduler.thread_affinity, Scheduler::AsyncCallbackNonDefaultIsolate, isolate_ptr_ptr);
+			Post(std::move(isolate_ptr));
 		}
 		return true;
 	} else {
@@ -328,13 +368,31 @@ bool IsolateEnvironment::Scheduler::Lock::WakeIsolate(shared_ptr<IsolateEnvironm
 	}
 }
 
-void IsolateEnvironment::Scheduler::Lock::InterruptIsolate(IsolateEnvironment& isolate) {
-	assert(scheduler.status == Status::Running);
+void IsolateEnvironment::Scheduler::Post(shared_ptr<IsolateEnvironment> isolate_ptr, bool low_priority) {
+	cpu_quota_t* quota = cpu_quota;
+	if (quota != nullptr) {
+		auto delay = quota->throttle();
+		if (delay != std::chrono::nanoseconds{}) {
+			// Over quota. Try again when enough usage has fallen out of the window, and then wait behind
+			// isolates which are under their quota.
+			auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(delay).count() + 1;
+			timer_t::wait_detached(ms, [ this, isolate_ptr ](void* /* next */) {
+				Post(isolate_ptr, true);
+			});
+			return;
+		}
+	}
+	thread_pool_t* group = thread_pool_group;
+	thread_pool_t& pool = group == nullptr ? thread_pool : *group;
+	pool.exec(thread_affinity, Scheduler::AsyncCallbackNonDefaultIsolate, new shared_ptr<IsolateEnvironment>(std::move(isolate_ptr)), low_priority);
+}
+
+void IsolateEnvironment::Scheduler::InterruptIsolate(IsolateEnvironment& isolate) {
 	// Since this callback will be called by v8 we can be certain the pointer to `isolate` is still valid
 	isolate->RequestInterrupt(AsyncCallbackInterrupt, static_cast<void*>(&isolate));
 }
 
-void IsolateEnvironment::Scheduler::Lock::InterruptSyncIsolate(IsolateEnvironment& isolate) {
+void IsolateEnvironment::Scheduler::InterruptSyncIsolate(IsolateEnvironment& isolate) {
 	isolate->RequestInterrupt(SyncCallbackInterrupt, static_cast<void*>(&isolate));
 }
 
@@ -371,6 +429,52 @@ void IsolateEnvironment::Scheduler::AsyncWait::Wake() {
 	}
 }
 
+/**
+ * HandleDisposer implementation
+ */
+void IsolateEnvironment::HandleDisposer::Push(const Entry* entries, size_t count) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (disposed) {
+		for (size_t ii = 0; ii < count; ++ii) {
+			entries[ii].first(entries[ii].second, false);
+		}
+	} else if (Executor::GetCurrent() == env) {
+		for (size_t ii = 0; ii < count; ++ii) {
+			entries[ii].first(entries[ii].second, true);
+		}
+		env->remotes_count.fetch_sub(count);
+	} else {
+		handles.insert(handles.end(), entries, entries + count);
+	}
+}
+
+void IsolateEnvironment::HandleDisposer::Flush() {
+	std::vector<Entry> tmp;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (handles.empty()) {
+			return;
+		}
+		std::swap(tmp, handles);
+	}
+	for (auto& entry : tmp) {
+		entry.first(entry.second, true);
+	}
+	env->remotes_count.fetch_sub(tmp.size());
+}
+
+void IsolateEnvironment::HandleDisposer::Dispose(bool reset) {
+	std::vector<Entry> tmp;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		disposed = true;
+		std::swap(tmp, handles);
+	}
+	for (auto& entry : tmp) {
+		entry.first(entry.second, reset);
+	}
+}
+
 /**
  * HeapCheck implementation
  */
@@ -380,16 +484,19 @@ IsolateEnvironment::HeapCheck::HeapCheck(IsolateEnvironment& env, bool force) :
 
 void IsolateEnvironment::HeapCheck::Epilogue() {
 	if (!env.root && (force || env.extra_allocated_memory != extra_size_before)) {
-		Isolate* isolate = env.GetIsolate();
-		HeapStatistics heap;
-		isolate->GetHeapStatistics(&heap);
-		if (heap.used_heap_size() + env.extra_allocated_memory > env.memory_limit) {
-			isolate->LowMemoryNotification();
-			isolate->GetHeapStatistics(&heap);
-			if (heap.used_heap_size() + env.extra_allocated_memory > env.memory_limit) {
-				env.hit_memory_limit = true;
-				env.Terminate();
-				throw js_fatal_error("Isolate was disposed during execution due to memory limit");
+		// The estimate errs on the high side, so the heap is only measured once it says we're over. A
+		// forced check follows code which may have allocated anywhere in the v8 heap, but anything
+		// significant will have been through a collection which has already raised the estimate.
+		if (env.IsOverMemoryLimit(0, env.memory_limit)) {
+			env.RefreshHeapSize();
+			if (env.IsOverMemoryLimit(0, env.memory_limit)) {
+				env.GetIsolate()->LowMemoryNotification();
+				env.RefreshHeapSize();
+				if (env.IsOverMemoryLimit(0, env.memory_limit)) {
+					env.hit_memory_limit = true;
+					env.Terminate();
+					throw js_fatal_error("Isolate was disposed during execution due to memory limit");
+				}
 			}
 		}
 	}
@@ -432,14 +539,22 @@ void IsolateEnvironment::OOMErrorCallback(const char* location, bool is_heap_oom
 void IsolateEnvironment::PromiseRejectCallback(PromiseRejectMessage rejection) {
 	auto that = IsolateEnvironment::GetCurrent();
 	assert(that->isolate == Isolate::GetCurrent());
+	if (rejection.GetEvent() == PromiseRejectEvent::kPromiseHandlerAddedAfterReject) {
+		// The rejection was handled after all, as long as it's the one which was going to be thrown
+		if (that->rejected_promise == rejection.GetPromise()) {
+			that->rejected_promise.Reset();
+			that->rejected_promise_error.Reset();
+		}
+		return;
+	}
+	that->rejected_promise.Reset(that->isolate, rejection.GetPromise());
 	that->rejected_promise_error.Reset(that->isolate, rejection.GetValue());
 }
 
 void IsolateEnvironment::MarkSweepCompactEpilogue(Isolate* isolate, GCType gc_type, GCCallbackFlags gc_flags, void* data) {
 	auto that = static_cast<IsolateEnvironment*>(data);
-	HeapStatistics heap;
-	that->isolate->GetHeapStatistics(&heap);
-	size_t total_memory = heap.used_heap_size() + that->extra_allocated_memory;
+	that->handle_disposer->Flush();
+	size_t total_memory = that->RefreshHeapSize() + that->extra_allocated_memory;
 	size_t memory_limit = that->memory_limit + that->misc_memory_size;
 	if (total_memory > memory_limit) {
 		if (gc_flags & (GCCallbackFlags::kGCCallbackFlagCollectAllAvailableGarbage | GCCallbackFlags::kGCCallbackFlagForced)) {
@@ -468,14 +583,37 @@ void IsolateEnvironment::MarkSweepCompactEpilogue(Isolate* isolate, GCType gc_ty
 	}
 }
 
+ExternalCopyCache& IsolateEnvironment::GetCopyCache() {
+	if (!copy_cache) {
+		// The default isolate has no memory limit
+		size_t budget = root ? 64 * 1024 * 1024 : memory_limit / 8;
+		copy_cache = std::make_unique<ExternalCopyCache>(budget);
+	}
+	return *copy_cache;
+}
+
+void IsolateEnvironment::ScavengeEpilogue(Isolate* /* isolate */, GCType /* gc_type */, GCCallbackFlags /* gc_flags */, void* data) {
+	// Objects promoted out of the young generation are the main source of heap growth between full
+	// collections. Instead of measuring the heap after every scavenge assume the worst, that a whole
+	// semi-space of survivors was promoted. Limit checks measure the heap for real once this estimate
+	// reaches the limit.
+	auto that = static_cast<IsolateEnvironment*>(data);
+	that->used_heap_size += that->young_generation_size;
+}
+
+size_t IsolateEnvironment::RefreshHeapSize() {
+	HeapStatistics heap;
+	isolate->GetHeapStatistics(&heap);
+	used_heap_size = heap.used_heap_size();
+	return used_heap_size;
+}
+
 size_t IsolateEnvironment::NearHeapLimitCallback(void* data, size_t current_heap_limit, size_t /* initial_heap_limit */) {
 	// This callback will temporarily give the v8 vm up to an extra 1 GB of memory to prevent the
 	// application from crashing.
 	auto that = static_cast<IsolateEnvironment*>(data);
 	that->did_adjust_heap_limit = true;
-	HeapStatistics heap;
-	that->isolate->GetHeapStatistics(&heap);
-	if (heap.used_heap_size() + that->extra_allocated_memory > that->memory_limit + that->misc_memory_size) {
+	if (that->RefreshHeapSize() + that->extra_allocated_memory > that->memory_limit + that->misc_memory_size) {
 		that->RequestMemoryPressureNotification(MemoryPressureLevel::kCritical, true, true);
 	} else {
 		that->RequestMemoryPressureNotification(MemoryPressureLevel::kModerate, true, true);
@@ -530,20 +668,39 @@ void IsolateEnvironment::AsyncEntry() {
 		}
 	}
 
+	cpu_quota_t* quota = scheduler.cpu_quota;
+	std::chrono::nanoseconds cpu_time{};
+	if (quota != nullptr) {
+		cpu_time = GetCpuTime();
+	}
+
 	while (true) {
-		std::queue<unique_ptr<Runnable>> tasks;
-		std::queue<unique_ptr<Runnable>> handle_tasks;
-		std::queue<unique_ptr<Runnable>> interrupts;
-		{
-			// Grab current tasks
-			Scheduler::Lock lock(scheduler);
-			tasks = lock.TakeTasks();
-			handle_tasks = lock.TakeHandleTasks();
-			interrupts = lock.TakeInterrupts();
-			if (tasks.empty() && handle_tasks.empty() && interrupts.empty()) {
-				lock.DoneRunning();
+		if (quota != nullptr) {
+			// Charge the quota for the last round of tasks and give up the thread if it's used up
+			auto now = GetCpuTime();
+			quota->charge(now - cpu_time);
+			cpu_time = now;
+			if (!scheduler.tasks.empty() && quota->throttle() != std::chrono::nanoseconds{}) {
+				auto isolate_ptr = holder->GetIsolate();
+				if (isolate_ptr) {
+					// The isolate stays in the `Running` state until the deferred wake picks it back up
+					Scheduler::IncrementUvRef();
+					scheduler.Post(std::move(isolate_ptr));
+					return;
+				}
+			}
+		}
+
+		// Grab current tasks
+		handle_disposer->Flush();
+		auto interrupts = scheduler.TakeInterrupts();
+		auto handle_tasks = scheduler.TakeHandleTasks();
+		auto tasks = scheduler.TakeTasks();
+		if (tasks.empty() && handle_tasks.empty() && interrupts.empty()) {
+			if (scheduler.DoneRunning()) {
 				return;
 			}
+			continue;
 		}
 
 		// Execute interrupt tasks
@@ -557,6 +714,7 @@ void IsolateEnvironment::AsyncEntry() {
 			handle_tasks.front()->Run();
 			handle_tasks.pop();
 		}
+		FlushContextDisposals();
 
 		// Execute tasks
 		while (!tasks.empty()) {
@@ -570,18 +728,14 @@ void IsolateEnvironment::AsyncEntry() {
 	}
 }
 
-template <std::queue<std::unique_ptr<Runnable>> (IsolateEnvironment::Scheduler::Lock::*Take)()>
+template <IsolateEnvironment::Scheduler::TaskList (IsolateEnvironment::Scheduler::*Take)()>
 void IsolateEnvironment::InterruptEntry() {
 	// Executor::Lock is already acquired
 	while (true) {
 		// Get interrupt callbacks
-		std::queue<unique_ptr<Runnable>> interrupts;
-		{
-			Scheduler::Lock lock(scheduler);
-			interrupts = (lock.*Take)();
-			if (interrupts.empty()) {
-				return;
-			}
+		auto interrupts = (scheduler.*Take)();
+		if (interrupts.empty()) {
+			return;
 		}
 
 		// Run the interrupts
@@ -594,6 +748,7 @@ void IsolateEnvironment::InterruptEntry() {
 
 IsolateEnvironment::IsolateEnvironment() :
 	executor(*this),
+	handle_disposer(std::make_shared<HandleDisposer>(this)),
 	bookkeeping_statics(bookkeeping_statics_shared) {
 }
 
@@ -615,7 +770,9 @@ void IsolateEnvironment::IsolateCtor(size_t memory_limit_in_mb, shared_ptr<void>
 
 	// Calculate resource constraints
 	ResourceConstraints rc;
-	rc.set_max_semi_space_size_in_kb((size_t)std::pow(2, memory_limit_in_mb / 128.0 + 10.0));
+	auto max_semi_space_size_in_kb = (size_t)std::pow(2, memory_limit_in_mb / 128.0 + 10.0);
+	rc.set_max_semi_space_size_in_kb(max_semi_space_size_in_kb);
+	young_generation_size = max_semi_space_size_in_kb * 1024;
 	rc.set_max_old_space_size(
 #if V8_AT_LEAST(7, 0, 0)
 		memory_limit_in_mb
@@ -650,6 +807,7 @@ void IsolateEnvironment::IsolateCtor(size_t memory_limit_in_mb, shared_ptr<void>
 
 	// Add GC callbacks
 	isolate->AddGCEpilogueCallback(MarkSweepCompactEpilogue, static_cast<void*>(this), GCType::kGCTypeMarkSweepCompact);
+	isolate->AddGCEpilogueCallback(ScavengeEpilogue, static_cast<void*>(this), GCType::kGCTypeScavenge);
 	isolate->AddNearHeapLimitCallback(NearHeapLimitCallback, static_cast<void*>(this));
 
 	// Heap statistics crushes down lots of different memory spaces into a single number. We note the
@@ -657,22 +815,28 @@ void IsolateEnvironment::IsolateCtor(size_t memory_limit_in_mb, shared_ptr<void>
 	HeapStatistics heap;
 	isolate->GetHeapStatistics(&heap);
 	initial_heap_size_limit = heap.heap_size_limit();
+	RefreshHeapSize();
 	misc_memory_size = heap.heap_size_limit() - memory_limit_in_mb * 1024 * 1024;
 
-	// Create a default context for the library to use if needed
+	// Create a default context for the library to use if needed. The isolate scope matters when this
+	// runs off the main thread because LimitedAllocator relies on `Isolate::GetCurrent()`.
 	{
 		Locker locker(isolate);
+		Isolate::Scope isolate_scope(isolate);
 		HandleScope handle_scope(isolate);
 		default_context.Reset(isolate, NewContext());
 	}
 
-	// There is no asynchronous Isolate ctor so we should throw away thread specifics in case
-	// the client always uses async methods
+	// This thread may never run the isolate again (the client may always use async methods, or it
+	// was built by IsolatePool) so we should throw away thread specifics
 	isolate->DiscardThreadSpecificMetadata();
 }
 
 IsolateEnvironment::~IsolateEnvironment() {
 	if (root) {
+		handle_disposer->Dispose(false);
+		// Like the handles above, these can't be reset once nodejs has torn down its isolate
+		copy_cache.release(); // NOLINT(bugprone-unused-return-value)
 		return;
 	}
 	{
@@ -694,11 +858,13 @@ IsolateEnvironment::~IsolateEnvironment() {
 		}
 		assert(weak_persistents.empty());
 		// Destroy outstanding tasks. Do this here while the executor lock is up.
-		Scheduler::Lock lock2(scheduler);
-		lock2.TakeInterrupts();
-		lock2.TakeSyncInterrupts();
-		lock2.TakeHandleTasks();
-		lock2.TakeTasks();
+		scheduler.TakeInterrupts();
+		scheduler.TakeSyncInterrupts();
+		scheduler.TakeHandleTasks();
+		scheduler.TakeTasks();
+		handle_disposer->Dispose(true);
+		context_pool.clear();
+		copy_cache.reset();
 	}
 	{
 		// Dispose() will call destructors for external strings and array buffers, so this lock sets the
@@ -721,6 +887,58 @@ Local<Context> IsolateEnvironment::NewContext() {
 #endif
 }
 
+Local<Context> IsolateEnvironment::TakeContext() {
+	Local<Context> context;
+	if (context_pool.empty()) {
+		context = NewContext();
+	} else {
+		context = Local<Context>::New(isolate, context_pool.back());
+		context_pool.pop_back();
+	}
+	ScheduleContextPoolRefill();
+	return context;
+}
+
+void IsolateEnvironment::SetContextPoolSize(size_t size) {
+	context_pool_size = size;
+	ScheduleContextPoolRefill();
+}
+
+void IsolateEnvironment::ScheduleContextPoolRefill() {
+	if (!context_pool_refill_scheduled && context_pool.size() < context_pool_size) {
+		struct RefillContextPoolTask : public Runnable {
+			void Run() final {
+				IsolateEnvironment::GetCurrent()->RefillContextPool();
+			}
+		};
+		context_pool_refill_scheduled = true;
+		holder->ScheduleTask(std::make_unique<RefillContextPoolTask>(), false, true);
+	}
+}
+
+void IsolateEnvironment::RefillContextPool() {
+	context_pool_refill_scheduled = false;
+	while (context_pool.size() < context_pool_size && !hit_memory_limit) {
+		HandleScope handle_scope(isolate);
+		Local<Context> context = NewContext();
+		if (context.IsEmpty()) {
+			break;
+		}
+		context_pool.emplace_back(isolate, context);
+	}
+}
+
+void IsolateEnvironment::ContextDisposed() {
+	++disposed_contexts;
+}
+
+void IsolateEnvironment::FlushContextDisposals() {
+	if (disposed_contexts != 0) {
+		disposed_contexts = 0;
+		isolate->ContextDisposedNotification();
+	}
+}
+
 void IsolateEnvironment::TaskEpilogue() {
 	isolate->RunMicrotasks();
 	CheckMemoryPressure();
@@ -731,6 +949,7 @@ void IsolateEnvironment::TaskEpilogue() {
 		Context::Scope context_scope(DefaultContext());
 		isolate->ThrowException(Local<Value>::New(isolate, rejected_promise_error));
 		rejected_promise_error.Reset();
+		rejected_promise.Reset();
 		throw js_runtime_error();
 	}
 }
@@ -739,6 +958,15 @@ void IsolateEnvironment::EnableInspectorAgent() {
 	inspector_agent = std::make_unique<InspectorAgent>(*this);
 }
 
+void IsolateEnvironment::SetThreadPoolGroup(thread_pool_t* group) {
+	scheduler.thread_pool_group = group;
+}
+
+void IsolateEnvironment::SetCpuQuota(shared_ptr<cpu_quota_t> quota) {
+	cpu_quota = std::move(quota);
+	scheduler.cpu_quota = cpu_quota.get();
+}
+
 InspectorAgent* IsolateEnvironment::GetInspectorAgent() const {
 	return inspector_agent.get();
 }
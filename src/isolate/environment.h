@@ -3,6 +3,9 @@
 #include <uv.h>
 
 #include "holder.h"
+#include "../code_cache_store.h"
+#include "../cpu_quota.h"
+#include "../mpsc_queue.h"
 #include "../thread_pool.h"
 
 #include <atomic>
@@ -11,12 +14,18 @@
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
+#if USE_CLOCK_THREAD_CPUTIME_ID
+#include <pthread.h>
+#include <time.h>
+#endif
+
 namespace ivm {
 
+class ExternalCopyCache;
 class Runnable;
 
 /**
@@ -35,7 +44,7 @@ class IsolateEnvironment {
 	friend class LimitedAllocator;
 	friend class ThreePhaseTask;
 	template <typename F>
-	friend v8::Local<v8::Value> RunWithTimeout(uint32_t timeout_ms, F&& fn);
+	friend v8::Local<v8::Value> RunWithTimeout(uint32_t timeout_ms, uint32_t cpu_timeout_ms, F&& fn);
 	template <typename ...Types>
 	friend class RemoteTuple;
 
@@ -66,6 +75,10 @@ class IsolateEnvironment {
 					Executor& executor;
 					CpuTimer* last;
 					TimePoint time;
+#if USE_CLOCK_THREAD_CPUTIME_ID
+					// CPU clock of the thread which owns this timer, so other threads can read it
+					clockid_t clock_id;
+#endif
 					explicit CpuTimer(Executor& executor);
 					CpuTimer(const CpuTimer&) = delete;
 					CpuTimer operator= (const CpuTimer&) = delete;
@@ -74,6 +87,9 @@ class IsolateEnvironment {
 					void Pause();
 					void Resume();
 					static TimePoint Now();
+#if USE_CLOCK_THREAD_CPUTIME_ID
+					static TimePoint Now(clockid_t clock_id);
+#endif
 				};
 
 				// WallTimer is also responsible for pausing the current CpuTimer before we attempt to
@@ -162,8 +178,11 @@ class IsolateEnvironment {
 			friend IsolateEnvironment;
 			public:
 				enum class Status { Waiting, Running };
+				using TaskQueue = mpsc_queue_t<Runnable>;
+				using TaskList = TaskQueue::list_t;
 
-				// A Scheduler::Lock is needed to interact with the task queue
+				// A Scheduler::Lock is needed for the odds and ends which aren't lock-free. The task queues
+				// and run state don't need it.
 				class Lock {
 					friend class AsyncWait;
 					private:
@@ -174,23 +193,6 @@ class IsolateEnvironment {
 						Lock(const Lock&) = delete;
 						Lock operator= (const Lock&) = delete;
 						~Lock();
-						void DoneRunning();
-						// Add work to the task queue
-						void PushTask(std::unique_ptr<Runnable> task);
-						void PushHandleTask(std::unique_ptr<Runnable> handle_task);
-						void PushInterrupt(std::unique_ptr<Runnable> interrupt);
-						void PushSyncInterrupt(std::unique_ptr<Runnable> interrupt);
-						// Takes control of current tasks. Resets current queue
-						std::queue<std::unique_ptr<Runnable>> TakeTasks();
-						std::queue<std::unique_ptr<Runnable>> TakeHandleTasks();
-						std::queue<std::unique_ptr<Runnable>> TakeInterrupts();
-						std::queue<std::unique_ptr<Runnable>> TakeSyncInterrupts();
-						// Returns true if a wake was scheduled, true if the isolate is already running.
-						bool WakeIsolate(std::shared_ptr<IsolateEnvironment> isolate_ptr);
-						// Request an interrupt in this isolate. `status` must == Running to invoke this.
-						void InterruptIsolate(IsolateEnvironment& isolate);
-						// Interrupts an isolate running in the default thread
-						void InterruptSyncIsolate(IsolateEnvironment& isolate);
 				};
 
 				// Scheduler::AsyncWait will pause the current thread until woken up by another thread
@@ -212,17 +214,21 @@ class IsolateEnvironment {
 			private:
 				static uv_async_t root_async;
 				static thread_pool_t thread_pool;
+				static std::mutex thread_pool_groups_mutex;
+				static std::unordered_map<std::string, std::unique_ptr<thread_pool_t>> thread_pool_groups;
 				static std::atomic<unsigned int> uv_ref_count;
 				static Scheduler* default_scheduler;
-				Status status = Status::Waiting;
+				std::atomic<Status> status{Status::Waiting};
 				std::mutex mutex;
 				std::mutex wait_mutex;
 				std::condition_variable_any wait_cv;
-				std::queue<std::unique_ptr<Runnable>> tasks;
-				std::queue<std::unique_ptr<Runnable>> handle_tasks;
-				std::queue<std::unique_ptr<Runnable>> interrupts;
-				std::queue<std::unique_ptr<Runnable>> sync_interrupts;
+				TaskQueue tasks;
+				TaskQueue handle_tasks;
+				TaskQueue interrupts;
+				TaskQueue sync_interrupts;
 				thread_pool_t::affinity_t thread_affinity;
+				std::atomic<thread_pool_t*> thread_pool_group{nullptr};
+				std::atomic<cpu_quota_t*> cpu_quota{nullptr};
 				AsyncWait* async_wait = nullptr;
 
 			public:
@@ -236,8 +242,49 @@ class IsolateEnvironment {
 				 */
 				static void IncrementUvRef();
 				static void DecrementUvRef();
+				/**
+				 * Resizes the shared thread pool, or a named pool group if `group` is not empty. Groups are
+				 * created on first use and only run isolates which were pinned to them, so their workers are
+				 * reserved for those isolates.
+				 */
+				static void SetThreadPoolSize(size_t size, const std::string& group = "");
+				/**
+				 * Returns the named pool group, or nullptr if it hasn't been created.
+				 */
+				static thread_pool_t* GetThreadPoolGroup(const std::string& group);
+				/**
+				 * Runs a task on the shared thread pool which isn't tied to any isolate. Low priority tasks
+				 * only start when the pool has nothing else to do.
+				 */
+				static void RunInThreadPool(thread_pool_t::affinity_t& affinity, thread_pool_t::entry_t* entry, void* param, bool low_priority = false);
+				/**
+				 * Returns the size of the shared thread pool.
+				 */
+				static size_t ThreadPoolSize();
+				// Add work to the task queue. These may be called from any thread without a lock.
+				void PushTask(std::unique_ptr<Runnable> task);
+				void PushHandleTask(std::unique_ptr<Runnable> handle_task);
+				void PushInterrupt(std::unique_ptr<Runnable> interrupt);
+				void PushSyncInterrupt(std::unique_ptr<Runnable> interrupt);
+				// Takes control of current tasks. Resets current queue
+				TaskList TakeTasks();
+				TaskList TakeHandleTasks();
+				TaskList TakeInterrupts();
+				TaskList TakeSyncInterrupts();
+				// Returns true if a wake was scheduled, false if the isolate is already running.
+				bool WakeIsolate(std::shared_ptr<IsolateEnvironment> isolate_ptr);
+				// Request an interrupt in this isolate. If the isolate isn't running the interrupt will be
+				// picked up the next time it is.
+				void InterruptIsolate(IsolateEnvironment& isolate);
+				// Interrupts an isolate running in the default thread
+				void InterruptSyncIsolate(IsolateEnvironment& isolate);
 
 			private:
+				// Called by the running thread when it is out of work. Returns false if more work showed up
+				// in the meantime, in which case the caller still owns the isolate and should keep going.
+				bool DoneRunning();
+				// Queues the isolate on its thread pool, or on a timer if it's over its CPU quota
+				void Post(std::shared_ptr<IsolateEnvironment> isolate_ptr, bool low_priority = false);
 				static void AsyncCallbackCommon(bool pool_thread, void* param);
 				static void AsyncCallbackDefaultIsolate(uv_async_t* async);
 				static void AsyncCallbackNonDefaultIsolate(bool pool_thread, void* param);
@@ -260,6 +307,35 @@ class IsolateEnvironment {
 				void Epilogue();
 		};
 
+		/**
+		 * Collects persistent handles released by `RemoteTuple` from any thread, and resets them in bulk
+		 * the next time the isolate runs. This avoids scheduling a task for every single handle.
+		 */
+		class HandleDisposer {
+			public:
+				// Deletes the handle, and calls `Reset()` first if `reset` is true
+				using DisposeFn = void(*)(void* handle, bool reset);
+				using Entry = std::pair<DisposeFn, void*>;
+
+			private:
+				std::mutex mutex;
+				std::vector<Entry> handles;
+				IsolateEnvironment* env;
+				bool disposed = false;
+
+			public:
+				explicit HandleDisposer(IsolateEnvironment* env) : env(env) {}
+				HandleDisposer(const HandleDisposer&) = delete;
+				HandleDisposer& operator= (const HandleDisposer&) = delete;
+				// Takes ownership of `count` handles. If this isolate is current they are reset immediately.
+				void Push(const Entry* entries, size_t count);
+				// Resets all pending handles. Executor::Lock must be held.
+				void Flush();
+				// Called once the isolate is going away. Pending handles are reset if `reset` is true, and
+				// any handles pushed after this are deleted without being reset.
+				void Dispose(bool reset);
+		};
+
 		/**
 		 * Like thread_local data, but specific to an Isolate instead.
 		 */
@@ -325,6 +401,11 @@ class IsolateEnvironment {
 		std::shared_ptr<IsolateHolder> holder;
 		std::unique_ptr<class InspectorAgent> inspector_agent;
 		v8::Persistent<v8::Context> default_context;
+		std::vector<v8::Global<v8::Context>> context_pool;
+		std::unique_ptr<ExternalCopyCache> copy_cache;
+		size_t context_pool_size = 0;
+		bool context_pool_refill_scheduled = false;
+		unsigned int disposed_contexts = 0;
 		std::unique_ptr<v8::ArrayBuffer::Allocator> allocator_ptr;
 		std::shared_ptr<void> snapshot_blob_ptr;
 		v8::StartupData startup_data;
@@ -338,9 +419,19 @@ class IsolateEnvironment {
 		bool did_adjust_heap_limit = false;
 		bool root;
 		std::atomic<unsigned int> remotes_count{0};
-		v8::HeapStatistics last_heap {};
+		std::shared_ptr<HandleDisposer> handle_disposer;
+		std::shared_ptr<cpu_quota_t> cpu_quota;
+		std::shared_ptr<code_cache_store_t> code_cache_store;
+		// Estimate of v8 heap usage. It's measured after full collections and raised by the size of the
+		// young generation after each scavenge, so it only ever errs on the high side. Limit checks
+		// compare against this instead of polling `GetHeapStatistics()`, and only measure the heap
+		// when the estimate says the limit is at risk.
+		size_t used_heap_size = 0;
+		// Most a single scavenge can promote, which is the semi-space size this isolate was created with
+		size_t young_generation_size = 0;
 		std::shared_ptr<BookkeepingStatics> bookkeeping_statics;
 		v8::Persistent<v8::Value> rejected_promise_error;
+		v8::Persistent<v8::Promise> rejected_promise;
 
 		std::vector<std::unique_ptr<v8::Eternal<v8::Data>>> specifics;
 		std::unordered_map<v8::Persistent<v8::Object>*, std::pair<void(*)(void*), void*>> weak_persistents;
@@ -368,16 +459,26 @@ class IsolateEnvironment {
 		 * GC hooks to kill this isolate before it runs out of memory
 		 */
 		static void MarkSweepCompactEpilogue(v8::Isolate* isolate, v8::GCType gc_type, v8::GCCallbackFlags gc_flags, void* data);
+		static void ScavengeEpilogue(v8::Isolate* isolate, v8::GCType gc_type, v8::GCCallbackFlags gc_flags, void* data);
 		static size_t NearHeapLimitCallback(void* data, size_t current_heap_limit, size_t initial_heap_limit);
 		void RequestMemoryPressureNotification(v8::MemoryPressureLevel memory_pressure, bool is_reentrant_gc = false, bool as_interrupt = false);
 		static void MemoryPressureInterrupt(v8::Isolate* isolate, void* data);
 		void CheckMemoryPressure();
 
+		/**
+		 * Heap accounting. `IsOverMemoryLimit` is a cheap check against the estimated heap size, and
+		 * `RefreshHeapSize` measures the heap to bring that number up to date.
+		 */
+		bool IsOverMemoryLimit(size_t length, size_t limit) const {
+			return used_heap_size + extra_allocated_memory + length > limit;
+		}
+		size_t RefreshHeapSize();
+
 		/**
 		 * Called by Scheduler when there is work to be done in this isolate.
 		 */
 		void AsyncEntry();
-		template <std::queue<std::unique_ptr<Runnable>> (Scheduler::Lock::*Take)()>
+		template <Scheduler::TaskList (Scheduler::*Take)()>
 		void InterruptEntry();
 
 		/**
@@ -390,6 +491,9 @@ class IsolateEnvironment {
 		 */
 		void IsolateCtor(size_t memory_limit_in_mb, std::shared_ptr<void> snapshot_blob, size_t snapshot_length);
 
+		void ScheduleContextPoolRefill();
+		void RefillContextPool();
+
 	public:
 		/**
 		 * The constructor should be called through the factory.
@@ -452,6 +556,24 @@ class IsolateEnvironment {
 		 */
 		v8::Local<v8::Context> NewContext();
 
+		/**
+		 * Returns a new context for user code. If a context pool was requested this hands out one which
+		 * was built ahead of time and schedules a task to build a replacement.
+		 */
+		v8::Local<v8::Context> TakeContext();
+
+		/**
+		 * Keep `size` spare contexts for `TakeContext`. Must be called before the isolate first runs.
+		 */
+		void SetContextPoolSize(size_t size);
+
+		/**
+		 * Called when a context is thrown away. v8 is notified once per batch of handle tasks instead of
+		 * for each context, since every notification kicks off GC heuristics.
+		 */
+		void ContextDisposed();
+		void FlushContextDisposals();
+
 		/**
 		 * This is called after user code runs. This throws a fatal error if the memory limit was hit.
 		 * If an asyncronous exception (promise) was lost, this will throw it for real.
@@ -465,6 +587,11 @@ class IsolateEnvironment {
 			return allocator_ptr.get();
 		}
 
+		/**
+		 * Cache of values materialized by `copy({ cache: true })`, created on first use.
+		 */
+		ExternalCopyCache& GetCopyCache();
+
 		/**
 		 * Get the initial v8 heap_size_limit when the isolate was created.
 		 */
@@ -477,6 +604,35 @@ class IsolateEnvironment {
 		 */
 		void EnableInspectorAgent();
 
+		/**
+		 * Pins this isolate to a thread pool group from `Scheduler::GetThreadPoolGroup`.
+		 */
+		void SetThreadPoolGroup(thread_pool_t* group);
+
+		/**
+		 * Shares a CPU quota with this isolate. Once the quota is used up, async work for this isolate
+		 * is deferred until it's back under the limit.
+		 */
+		void SetCpuQuota(std::shared_ptr<cpu_quota_t> quota);
+
+		/**
+		 * Sets the on-disk store which `compileScript()` will consult and fill automatically.
+		 */
+		void SetCodeCacheStore(std::shared_ptr<code_cache_store_t> store) {
+			code_cache_store = std::move(store);
+		}
+		std::shared_ptr<code_cache_store_t> GetCodeCacheStore() const {
+			return code_cache_store;
+		}
+
+		/**
+		 * Returns the snapshot this isolate was created from, or nullptr for v8's built-in snapshot.
+		 * The address only serves to tell snapshots apart.
+		 */
+		const void* GetSnapshotBlob() const {
+			return snapshot_blob_ptr.get();
+		}
+
 		/**
 		 * Returns the InspectorAgent for this Isolate.
 		 */
@@ -505,6 +661,13 @@ class IsolateEnvironment {
 			return remotes_count.load();
 		}
 
+		/**
+		 * Used by RemoteTuple to release its handles
+		 */
+		const std::shared_ptr<HandleDisposer>& GetHandleDisposer() const {
+			return handle_disposer;
+		}
+
 		/**
 		 * Is this the default nodejs isolate?
 		 */
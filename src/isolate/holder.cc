@@ -40,14 +40,14 @@ void IsolateHolder::ScheduleTask(unique_ptr<Runnable> task, bool run_inline, boo
 			task->Run();
 			return;
 		}
-		IsolateEnvironment::Scheduler::Lock lock(ref->scheduler);
+		IsolateEnvironment::Scheduler& scheduler = ref->scheduler;
 		if (handle_task) {
-			lock.PushHandleTask(std::move(task));
+			scheduler.PushHandleTask(std::move(task));
 		} else {
-			lock.PushTask(std::move(task));
+			scheduler.PushTask(std::move(task));
 		}
 		if (wake_isolate) {
-			lock.WakeIsolate(std::move(ref));
+			scheduler.WakeIsolate(std::move(ref));
 		}
 	}
 }
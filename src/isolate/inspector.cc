@@ -57,7 +57,7 @@ void InspectorAgent::runMessageLoopOnPause(int /* context_group_id */) {
 		lock.unlock();
 		{
 			IsolateEnvironment::Executor::CpuTimer::UnpauseScope unpause_cpu_timer{pause_cpu_timer};
-			isolate.InterruptEntry<&IsolateEnvironment::Scheduler::Lock::TakeInterrupts>();
+			isolate.InterruptEntry<&IsolateEnvironment::Scheduler::TakeInterrupts>();
 		}
 		lock.lock();
 	} while (running && !terminated);
@@ -104,7 +104,7 @@ void InspectorAgent::SendInterrupt(unique_ptr<class Runnable> task) {
 	shared_ptr<IsolateEnvironment> ptr = isolate.holder->GetIsolate();
 	assert(ptr);
 	// Push interrupt onto queue
-	IsolateEnvironment::Scheduler::Lock scheduler(isolate.scheduler);
+	IsolateEnvironment::Scheduler& scheduler = isolate.scheduler;
 	scheduler.PushInterrupt(std::move(task));
 	// Wake up the isolate
 	if (!scheduler.WakeIsolate(ptr)) { // `true` if isolate is inactive
@@ -23,8 +23,17 @@ class PlatformDelegate : public v8::Platform {
 	private:
 		v8::Isolate* node_isolate;
 		v8::Platform* node_platform;
-		TmpIsolateScope* tmp_scope = nullptr;
-		std::shared_ptr<IsolateHolder> isolate_ctor_holder;
+		// Isolates may be built on any thread (see IsolatePool and `Isolate.create`) so these are
+		// thread_local
+		static TmpIsolateScope*& TmpScope() {
+			static thread_local TmpIsolateScope* scope = nullptr;
+			return scope;
+		}
+
+		static const std::shared_ptr<IsolateHolder>*& IsolateCtorHolder() {
+			static thread_local const std::shared_ptr<IsolateHolder>* holder = nullptr;
+			return holder;
+		}
 
 		class TaskHolder : public Runnable {
 			private:
@@ -39,19 +48,20 @@ class PlatformDelegate : public v8::Platform {
 		};
 
 	public:
-		// TODO: This stuff isn't thread safe but since people tend to create isolates from the same
-		// thread it probably isn't a big issue (until it all of a sudden is).
+		// These scopes only apply to the thread which opened them, since v8 asks for the task runner from
+		// the same thread that is constructing the isolate.
 		struct TmpIsolateScope {
 			v8::Isolate* isolate = nullptr;
 			std::shared_ptr<std::vector<std::unique_ptr<v8::Task>>> foreground_tasks;
-			explicit TmpIsolateScope() : foreground_tasks(std::make_shared<std::vector<std::unique_ptr<v8::Task>>>()) {
-				PlatformDelegate::DelegateInstance().tmp_scope = this;
+			TmpIsolateScope* last;
+			explicit TmpIsolateScope() : foreground_tasks(std::make_shared<std::vector<std::unique_ptr<v8::Task>>>()), last(TmpScope()) {
+				TmpScope() = this;
 			}
 			TmpIsolateScope(TmpIsolateScope&) = delete;
 			TmpIsolateScope& operator=(const TmpIsolateScope&) = delete;
 
 			~TmpIsolateScope() {
-				PlatformDelegate::DelegateInstance().tmp_scope = nullptr;
+				TmpScope() = last;
 			}
 
 			bool IsIsolate(v8::Isolate* isolate) {
@@ -71,14 +81,16 @@ class PlatformDelegate : public v8::Platform {
 		};
 
 		struct IsolateCtorScope {
-			explicit IsolateCtorScope(std::shared_ptr<IsolateHolder> holder) {
-				PlatformDelegate::DelegateInstance().isolate_ctor_holder = std::move(holder);
+			std::shared_ptr<IsolateHolder> holder;
+			const std::shared_ptr<IsolateHolder>* last;
+			explicit IsolateCtorScope(std::shared_ptr<IsolateHolder> holder) : holder(std::move(holder)), last(IsolateCtorHolder()) {
+				IsolateCtorHolder() = &this->holder;
 			}
 			IsolateCtorScope(IsolateCtorScope&) = delete;
 			IsolateCtorScope& operator=(const IsolateCtorScope&) = delete;
 
 			~IsolateCtorScope() {
-				PlatformDelegate::DelegateInstance().isolate_ctor_holder.reset();
+				IsolateCtorHolder() = last;
 			}
 		};
 
@@ -236,15 +248,15 @@ class PlatformDelegate : public v8::Platform {
 				return node_platform->GetForegroundTaskRunner(isolate);
 			} else {
 				auto s_isolate = IsolateEnvironment::LookupIsolate(isolate);
-				if (!s_isolate) {
-					s_isolate = isolate_ctor_holder;
+				if (!s_isolate && IsolateCtorHolder() != nullptr) {
+					s_isolate = *IsolateCtorHolder();
 				}
 				if (s_isolate) {
 					// We could further assert that IsolateEnvironment::GetCurrent() == s_isolate
 					// TODO: Don't make a new runner each time
 					return std::make_shared<ForegroundTaskRunner>(s_isolate);
-				} else if (tmp_scope != nullptr && tmp_scope->IsIsolate(isolate)) {
-					return std::make_shared<TmpForegroundTaskRunner>(tmp_scope->foreground_tasks);
+				} else if (TmpScope() != nullptr && TmpScope()->IsIsolate(isolate)) {
+					return std::make_shared<TmpForegroundTaskRunner>(TmpScope()->foreground_tasks);
 				} else {
 					throw std::runtime_error("Unknown isolate");
 				}
@@ -256,14 +268,14 @@ class PlatformDelegate : public v8::Platform {
 				node_platform->CallOnForegroundThread(isolate, task);
 			} else {
 				auto s_isolate = IsolateEnvironment::LookupIsolate(isolate);
-				if (!s_isolate) {
-					s_isolate = isolate_ctor_holder;
+				if (!s_isolate && IsolateCtorHolder() != nullptr) {
+					s_isolate = *IsolateCtorHolder();
 				}
 				if (s_isolate) {
 					// wakeup == false but it shouldn't matter because this isolate is already awake
 					s_isolate->ScheduleTask(std::make_unique<TaskHolder>(task), false, false, true);
-				} else if (tmp_scope != nullptr && tmp_scope->IsIsolate(isolate)) {
-					tmp_scope->foreground_tasks->push_back(std::unique_ptr<v8::Task>(task));
+				} else if (TmpScope() != nullptr && TmpScope()->IsIsolate(isolate)) {
+					TmpScope()->foreground_tasks->push_back(std::unique_ptr<v8::Task>(task));
 				} else {
 					throw std::runtime_error("Unknown isolate");
 				}
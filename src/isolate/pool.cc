@@ -0,0 +1,91 @@
+#include "pool.h"
+#include "environment.h"
+
+using std::shared_ptr;
+
+namespace ivm {
+
+std::mutex IsolatePool::pools_mutex;
+
+std::vector<IsolatePool*>& IsolatePool::Pools() {
+	// Pools are never freed. Idle isolates would otherwise be disposed by static destructors after v8
+	// has already gone away.
+	static auto pools = new std::vector<IsolatePool*>;
+	return *pools;
+}
+
+IsolatePool* IsolatePool::Find(size_t memory_limit, const void* snapshot_blob) {
+	for (IsolatePool* pool : Pools()) {
+		if (pool->memory_limit == memory_limit && pool->snapshot_blob.get() == snapshot_blob) {
+			return pool;
+		}
+	}
+	return nullptr;
+}
+
+IsolatePool::IsolatePool(size_t memory_limit, shared_ptr<void> snapshot_blob, size_t snapshot_length) :
+	memory_limit(memory_limit), snapshot_blob(std::move(snapshot_blob)), snapshot_length(snapshot_length) {}
+
+void IsolatePool::Build(bool /* pool_thread */, void* param) {
+	auto& pool = *static_cast<IsolatePool*>(param);
+	// If the pool shrank while this was building then `isolate` is disposed after the lock is released
+	auto isolate = IsolateEnvironment::New(pool.memory_limit, pool.snapshot_blob, pool.snapshot_length);
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	--pool.building;
+	if (pool.ready.size() < pool.size) {
+		pool.ready.push_back(std::move(isolate));
+	}
+}
+
+void IsolatePool::Refill() {
+	while (ready.size() + building < size) {
+		++building;
+		IsolateEnvironment::Scheduler::RunInThreadPool(affinity, Build, this);
+	}
+}
+
+void IsolatePool::Resize(size_t size, size_t memory_limit, shared_ptr<void> snapshot_blob, size_t snapshot_length) {
+	IsolatePool* pool;
+	{
+		std::lock_guard<std::mutex> lock(pools_mutex);
+		pool = Find(memory_limit, snapshot_blob.get());
+		if (pool == nullptr) {
+			if (size == 0) {
+				return;
+			}
+			pool = new IsolatePool(memory_limit, std::move(snapshot_blob), snapshot_length);
+			Pools().push_back(pool);
+		}
+	}
+	std::deque<shared_ptr<IsolateHolder>> surplus;
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		pool->size = size;
+		while (pool->ready.size() > size) {
+			surplus.push_back(std::move(pool->ready.back()));
+			pool->ready.pop_back();
+		}
+		pool->Refill();
+	}
+}
+
+shared_ptr<IsolateHolder> IsolatePool::Take(size_t memory_limit, const void* snapshot_blob) {
+	IsolatePool* pool;
+	{
+		std::lock_guard<std::mutex> lock(pools_mutex);
+		pool = Find(memory_limit, snapshot_blob);
+		if (pool == nullptr) {
+			return nullptr;
+		}
+	}
+	std::lock_guard<std::mutex> lock(pool->mutex);
+	shared_ptr<IsolateHolder> isolate;
+	if (!pool->ready.empty()) {
+		isolate = std::move(pool->ready.front());
+		pool->ready.pop_front();
+	}
+	pool->Refill();
+	return isolate;
+}
+
+} // namespace ivm
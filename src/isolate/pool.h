@@ -0,0 +1,52 @@
+#pragma once
+#include "holder.h"
+#include "../thread_pool.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ivm {
+
+/**
+ * Keeps isolates built ahead of time so that `new Isolate()` doesn't have to wait on `Isolate::New`
+ * and the default context. There is one pool per combination of memory limit and snapshot, and each
+ * is topped back up in the background on the thread pool.
+ */
+class IsolatePool {
+	private:
+		size_t memory_limit;
+		std::shared_ptr<void> snapshot_blob;
+		size_t snapshot_length;
+		size_t size = 0;
+		size_t building = 0;
+		std::deque<std::shared_ptr<IsolateHolder>> ready;
+		std::mutex mutex;
+		thread_pool_t::affinity_t affinity;
+
+		static std::mutex pools_mutex;
+		static std::vector<IsolatePool*>& Pools();
+		static IsolatePool* Find(size_t memory_limit, const void* snapshot_blob);
+		static void Build(bool pool_thread, void* param);
+		// Must be called with `mutex` held
+		void Refill();
+
+	public:
+		IsolatePool(size_t memory_limit, std::shared_ptr<void> snapshot_blob, size_t snapshot_length);
+		IsolatePool(const IsolatePool&) = delete;
+		IsolatePool& operator= (const IsolatePool&) = delete;
+
+		/**
+		 * Sets the number of idle isolates to keep around for this configuration, creating the pool if
+		 * needed. A size of 0 releases any isolates which are waiting.
+		 */
+		static void Resize(size_t size, size_t memory_limit, std::shared_ptr<void> snapshot_blob, size_t snapshot_length);
+
+		/**
+		 * Returns a prebuilt isolate, or nullptr if there is no pool for this configuration or it has
+		 * run dry.
+		 */
+		static std::shared_ptr<IsolateHolder> Take(size_t memory_limit, const void* snapshot_blob);
+};
+
+} // namespace ivm
@@ -10,9 +10,10 @@ namespace ivm {
 
 /**
  * This holds a number of persistent handles to some values in a single isolate. It also holds a
- * handle to the isolate. When the destructor of this class is called it will run `Reset()` on each
- * handle in the context of the isolate. If the destructor of this class is called after the isolate
- * has been disposed then Reset() will not be called (but I don't think that causes a memory leak).
+ * handle to the isolate. When the destructor of this class is called the handles are passed to the
+ * isolate's HandleDisposer which will run `Reset()` on them in the context of the isolate. If the
+ * destructor of this class is called after the isolate has been disposed then Reset() will not be
+ * called (but I don't think that causes a memory leak).
  */
 template <typename ...Types>
 class RemoteTuple {
@@ -21,35 +22,35 @@ class RemoteTuple {
 		using HandleType = v8::Persistent<T, v8::NonCopyablePersistentTraits<T>>;
 
 		// This uses unique_ptrs because the handles may outlive the RemoteTuple instance (we need to
-		// transfer ownership to DisposalTask). It's a tuple of unique_ptrs and not the other way around
+		// transfer ownership to HandleDisposer). It's a tuple of unique_ptrs and not the other way around
 		// because there is no reasonable way to construct in place with tuple like there is with pair.
 		using HandlesType = std::tuple<std::unique_ptr<HandleType<Types>>...>;
 
-		// This calls Reset() on each handle.
-		struct DisposalTask : public Runnable {
-			HandlesType handles;
-			explicit DisposalTask(HandlesType&& handles) : handles(std::move(handles)) {}
-
-			template <int> void Reset() {}
-
-			template <int, typename T, typename ...Rest>
-			void Reset() {
-				std::get<sizeof...(Rest)>(handles)->Reset();
-				Reset<0, Rest...>();
+		// Passed to HandleDisposer along with the released handle
+		template <typename T>
+		static void DisposeHandle(void* ptr, bool reset) {
+			std::unique_ptr<HandleType<T>> handle(static_cast<HandleType<T>*>(ptr));
+			if (reset) {
+				handle->Reset();
 			}
+		}
 
-			void Run() final {
-				Reset<0, Types...>();
-				IsolateEnvironment::GetCurrent()->remotes_count.fetch_sub(sizeof...(Types));
-			}
-		};
+		template <size_t ...Indices>
+		void Dispose(std::index_sequence<Indices...> /* indices */) {
+			IsolateEnvironment::HandleDisposer::Entry entries[] = {
+				IsolateEnvironment::HandleDisposer::Entry(&DisposeHandle<Types>, std::get<Indices>(handles).release())...
+			};
+			disposer->Push(entries, sizeof...(Types));
+		}
 
 		std::shared_ptr<IsolateHolder> isolate;
+		std::shared_ptr<IsolateEnvironment::HandleDisposer> disposer;
 		HandlesType handles;
 
 	public:
 		explicit RemoteTuple(v8::Local<Types>... handles) :
 			isolate(IsolateEnvironment::GetCurrentHolder()),
+			disposer(IsolateEnvironment::GetCurrent()->GetHandleDisposer()),
 			handles(std::make_unique<HandleType<Types>>(v8::Isolate::GetCurrent(), std::move(handles))...)
 		{
 			IsolateEnvironment::GetCurrent()->remotes_count.fetch_add(sizeof...(Types));
@@ -57,7 +58,7 @@ class RemoteTuple {
 		}
 
 		~RemoteTuple() {
-			isolate->ScheduleTask(std::make_unique<DisposalTask>(std::move(handles)), true, false, true);
+			Dispose(std::index_sequence_for<Types...>{});
 		}
 
 		RemoteTuple(const RemoteTuple&) = delete;
@@ -4,45 +4,52 @@
 #include "runnable.h"
 #include "stack_trace.h"
 #include "../timer.h"
+#include <atomic>
+#include <cassert>
 #include <chrono>
 #include <memory>
-#include <thread>
+#include <mutex>
+#include <string>
 
 namespace ivm {
 
 /**
- * Cross-thread wait. I think I've implemented this same thing like three times with slightly
- * different requirements. It might be a good idea to abstract it out.
+ * Termination handshake for a single `RunWithTimeout` invocation. It's shared between the timers,
+ * the interrupt which terminates the script, and the thread running the script, so none of them
+ * ever has to wait on another.
  */
-class ThreadWait {
+class TerminationState {
 	private:
-		static std::mutex& global_mutex() {
-			static std::mutex mutex;
-			return mutex;
-		}
-
-		static std::condition_variable& global_cv() {
-			static std::condition_variable cv;
-			return cv;
-		}
-
-		bool finished = false;
+		std::mutex mutex;
+		bool did_timeout = false;
+		bool did_finish = false;
 
 	public:
-		ThreadWait() = default;
-		ThreadWait(const ThreadWait&) = delete;
-		ThreadWait& operator=(const ThreadWait&) = delete;
-		~ThreadWait() {
-			std::unique_lock<std::mutex> lock(global_mutex());
-			while (!finished) {
-				global_cv().wait(lock);
+		// TODO: This should be a StackStaceHolder instead which would avoid rendering the stack when it
+		// is not observed.
+		std::string stack_trace;
+		std::atomic<int> attempts{0};
+
+		// Called by a timer. Returns true if this call claimed the timeout.
+		bool Timeout() {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (did_timeout || did_finish) {
+				return false;
 			}
+			did_timeout = true;
+			return true;
+		}
+
+		// Called by the running thread when the invocation returns. Returns true if it timed out.
+		bool Finish() {
+			std::lock_guard<std::mutex> lock(mutex);
+			did_finish = true;
+			return did_timeout;
 		}
 
-		void Done() {
-			std::lock_guard<std::mutex> lock(global_mutex());
-			finished = true;
-			global_cv().notify_all();
+		bool IsFinished() {
+			std::lock_guard<std::mutex> lock(mutex);
+			return did_finish;
 		}
 };
 
@@ -50,103 +57,110 @@ class ThreadWait {
  * Grabs a stack trace of the runaway script
  */
 struct TimeoutRunner : public Runnable {
-	// TODO: This should return a StackStaceHolder instead which would avoid rendering the stack when
-	// it is not observed.
-	std::string& stack_trace;
-	ThreadWait& wait;
-
-	TimeoutRunner(std::string& stack_trace, ThreadWait& wait) : stack_trace(stack_trace), wait(wait) {}
-	TimeoutRunner(const TimeoutRunner&) = delete;
-	TimeoutRunner& operator=(const TimeoutRunner&) = delete;
+	std::shared_ptr<TerminationState> state;
 
-	~TimeoutRunner() final {
-		wait.Done();
-	}
+	explicit TimeoutRunner(std::shared_ptr<TerminationState> state) : state(std::move(state)) {}
 
 	void Run() final {
+		// This could be picked up after the invocation already finished, in which case it's a no-op
+		if (state->IsFinished()) {
+			return;
+		}
 		v8::Isolate* isolate = v8::Isolate::GetCurrent();
-		stack_trace = StackTraceHolder::RenderSingleStack(v8::StackTrace::CurrentStackTrace(isolate, 10));
+		state->stack_trace = StackTraceHolder::RenderSingleStack(v8::StackTrace::CurrentStackTrace(isolate, 10));
 		isolate->TerminateExecution();
 	}
 };
 
 /**
- * Run some v8 thing with a timeout. Also throws error if memory limit is hit.
+ * Reads a timeout option like `timeout` or `cpuTimeout`. 0 means no timeout.
+ */
+inline uint32_t ReadTimeoutOption(v8::Local<v8::Object> options, const char* key) {
+	v8::Local<v8::Value> timeout_handle = Unmaybe(options->Get(v8::Isolate::GetCurrent()->GetCurrentContext(), v8_string(key)));
+	if (timeout_handle->IsUndefined()) {
+		return 0;
+	} else if (!timeout_handle->IsUint32()) {
+		throw js_type_error(std::string("`")+ key+ "` must be integer");
+	}
+	return timeout_handle.As<v8::Uint32>()->Value();
+}
+
+/**
+ * Run some v8 thing with a timeout. `timeout_ms` is measured in wall time, and `cpu_timeout_ms` in
+ * CPU time spent by the isolate. Also throws error if memory limit is hit.
  */
 template <typename F>
-v8::Local<v8::Value> RunWithTimeout(uint32_t timeout_ms, F&& fn) {
+v8::Local<v8::Value> RunWithTimeout(uint32_t timeout_ms, uint32_t cpu_timeout_ms, F&& fn) {
 	IsolateEnvironment& isolate = *IsolateEnvironment::GetCurrent();
-	bool did_timeout = false, did_finish = false;
+	bool did_timeout = false;
 	bool is_default_thread = IsolateEnvironment::Executor::IsDefaultThread();
 	v8::MaybeLocal<v8::Value> result;
-	std::string stack_trace;
+	auto state = std::make_shared<TerminationState>();
 	{
-		std::unique_ptr<timer_t> timer_ptr;
-		if (timeout_ms != 0) {
-			timer_ptr = std::make_unique<timer_t>(timeout_ms, &isolate.timer_holder, [
-				&did_timeout, &did_finish, is_default_thread, &isolate, &stack_trace
-			](void* next) {
-				did_timeout = true;
+		auto terminate = [ state, is_default_thread, &isolate ](void* next) {
+			if (state->Timeout()) {
 				++isolate.terminate_depth;
-				{
-					ThreadWait wait;
-					auto timeout_runner = std::make_unique<TimeoutRunner>(stack_trace, wait);
-					if (is_default_thread) {
-						// In this case this is a pure sync function. We should not cancel any async waits.
-						IsolateEnvironment::Scheduler::Lock scheduler(isolate.scheduler);
-						scheduler.PushSyncInterrupt(std::move(timeout_runner));
-						scheduler.InterruptSyncIsolate(isolate);
-					} else {
-						{
-							IsolateEnvironment::Scheduler::Lock scheduler(isolate.scheduler);
-							scheduler.PushInterrupt(std::move(timeout_runner));
-							scheduler.InterruptIsolate(isolate);
-						}
-						isolate.CancelAsync();
-					}
-					timer_t::chain(next);
-					if (did_finish) {
-						// fn() could have finished and threw away the interrupts below before we got a chance
-						// to set them up. In this case we throw away the interrupts ourselves.
-						IsolateEnvironment::Scheduler::Lock scheduler(isolate.scheduler);
-						if (is_default_thread) {
-							scheduler.TakeSyncInterrupts();
-						} else {
-							scheduler.TakeInterrupts();
-						}
-					}
+				auto timeout_runner = std::make_unique<TimeoutRunner>(state);
+				IsolateEnvironment::Scheduler& scheduler = isolate.scheduler;
+				if (is_default_thread) {
+					// In this case this is a pure sync function. We should not cancel any async waits.
+					scheduler.PushSyncInterrupt(std::move(timeout_runner));
+					scheduler.InterruptSyncIsolate(isolate);
+				} else {
+					scheduler.PushInterrupt(std::move(timeout_runner));
+					scheduler.InterruptIsolate(isolate);
+					isolate.CancelAsync();
 				}
+			} else if (state->IsFinished()) {
+				return;
+			} else {
 				// FIXME(?): It seems that one call to TerminateExecution() doesn't kill the script if
 				// there is a promise handler scheduled. This is unexpected behavior but I can't
 				// reproduce it in vanilla v8 so the issue seems more complex. I'm punting on this for
 				// now with a hack but will look again when nodejs pulls in a newer version of v8 with
 				// more mature microtask support.
 				//
-				// This loop always terminates for me in 1 iteration but it goes up to 100 because the
-				// only other option is terminating the application if an isolate has gone out of
-				// control.
-				for (int ii = 0; ii < 100; ++ii) {
-					std::this_thread::sleep_for(std::chrono::duration<int, std::milli>(2));
-					if (did_finish) {
-						return;
-					}
-					isolate->TerminateExecution();
+				// This always terminates for me after 1 attempt but it goes up to 100 because the only
+				// other option is terminating the application if an isolate has gone out of control.
+				if (++state->attempts > 100) {
+					assert(false);
+					return;
+				}
+				isolate->TerminateExecution();
+			}
+			// Check back shortly. The timer is cancelled as soon as the invocation returns, and in the
+			// meantime the timer thread is free to run other timers.
+			timer_t::rearm(next, 2);
+		};
+		std::unique_ptr<timer_t> timer_ptr;
+		if (timeout_ms != 0) {
+			timer_ptr = std::make_unique<timer_t>(timeout_ms, &isolate.timer_holder, terminate);
+		}
+		std::unique_ptr<timer_t> cpu_timer_ptr;
+		if (cpu_timeout_ms != 0) {
+			auto cpu_limit = isolate.GetCpuTime() + std::chrono::milliseconds(cpu_timeout_ms);
+			cpu_timer_ptr = std::make_unique<timer_t>(cpu_timeout_ms, [&isolate, &terminate, cpu_limit](void* next) {
+				// CPU time can't advance faster than wall time so this never fires early. If the isolate
+				// was descheduled or paused then check again once the rest of the budget could be spent.
+				auto remaining = cpu_limit - isolate.GetCpuTime();
+				if (remaining > std::chrono::nanoseconds{0}) {
+					timer_t::rearm(next, std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count() + 1);
+				} else {
+					terminate(next);
 				}
-				assert(false);
 			});
 		}
 		result = fn();
-		did_finish = true;
-		{
+		did_timeout = state->Finish();
+		if (did_timeout) {
 			// It's possible that fn() finished and the timer triggered at the same time. So here we throw
-			// away existing interrupts to let the ThreadWait finish and also avoid interrupting an
-			// unrelated function call.
+			// away the timeout interrupt to avoid it lingering until an unrelated function call. It
+			// would be a no-op by then anyway.
 			// TODO: This probably breaks the inspector in some cases
-			IsolateEnvironment::Scheduler::Lock lock(isolate.scheduler);
 			if (is_default_thread) {
-				lock.TakeSyncInterrupts();
+				isolate.scheduler.TakeSyncInterrupts();
 			} else {
-				lock.TakeInterrupts();
+				isolate.scheduler.TakeInterrupts();
 			}
 		}
 	}
@@ -158,7 +172,7 @@ v8::Local<v8::Value> RunWithTimeout(uint32_t timeout_ms, F&& fn) {
 		if (--isolate.terminate_depth == 0) {
 			isolate->CancelTerminateExecution();
 		}
-		throw js_generic_error("Script execution timed out.", std::move(stack_trace));
+		throw js_generic_error("Script execution timed out.", std::move(state->stack_trace));
 	}
 	return Unmaybe(result);
 }
@@ -95,91 +95,158 @@ ThreePhaseTask::Phase2Runner::~Phase2Runner() {
 }
 
 void ThreePhaseTask::Phase2Runner::Run() {
-
-	// This class will be used if Phase2() throws an error
-	struct Phase3Failure : public Runnable {
-		unique_ptr<ThreePhaseTask> self;
-		unique_ptr<CalleeInfo> info;
-		unique_ptr<ExternalCopy> error;
-
-		Phase3Failure(
-			unique_ptr<ThreePhaseTask> self,
-			unique_ptr<CalleeInfo> info,
-			unique_ptr<ExternalCopy> error
-		) :
-			self(std::move(self)),
-			info(std::move(info)),
-			error(std::move(error)) {}
-
-		void Run() final {
-			// Revive our persistent handles
-			Isolate* isolate = Isolate::GetCurrent();
-			auto context_local = info->remotes.Deref<1>();
-			Context::Scope context_scope(context_local);
-			auto promise_local = info->remotes.Deref<0>();
-			CallbackScope callback_scope(info->async, promise_local);
-			Local<Value> rejection;
-			if (error) {
-				rejection = error->CopyInto();
-			} else {
-				rejection = Exception::Error(v8_string("An exception was thrown. Sorry I don't know more."));
-			}
-			if (rejection->IsObject()) {
-				StackTraceHolder::ChainStack(rejection.As<Object>(), info->remotes.Deref<2>());
-			}
-			// If Reject fails then I think that's bad..
-			Unmaybe(promise_local->Reject(context_local, rejection));
-			isolate->RunMicrotasks();
-		}
-	};
-
-	// This is called if Phase2() does not throw
-	struct Phase3Success : public Runnable {
-		unique_ptr<ThreePhaseTask> self;
-		unique_ptr<CalleeInfo> info;
-
-		Phase3Success(
-			unique_ptr<ThreePhaseTask> self,
-			unique_ptr<CalleeInfo> info
-		) :
-			self(std::move(self)),
-			info(std::move(info)) {}
-
-		void Run() final {
-			Isolate* isolate = Isolate::GetCurrent();
-			auto context_local = info->remotes.Deref<1>();
-			Context::Scope context_scope(context_local);
-			auto promise_local = info->remotes.Deref<0>();
-			CallbackScope callback_scope(info->async, promise_local);
-			FunctorRunners::RunCatchValue([&]() {
-				// Final callback
-				Unmaybe(promise_local->Resolve(context_local, self->Phase3()));
-			}, [&](Local<Value> error) {
-				// Error was thrown
-				if (error->IsObject()) {
-					StackTraceHolder::AttachStack(error.As<Object>(), info->remotes.Deref<2>());
-				}
-				Unmaybe(promise_local->Reject(context_local, error));
-			});
-			isolate->RunMicrotasks();
-		}
-	};
-
 	did_run = true;
 	FunctorRunners::RunCatchExternal(IsolateEnvironment::GetCurrent()->DefaultContext(), [ this ]() {
 		// Continue the task
-		self->Phase2();
+		Local<Promise> promise = self->Phase2Deferred();
+		if (!promise.IsEmpty()) {
+			// Phase 3 will be scheduled once the promise settles. The handlers are attached before
+			// `TaskEpilogue()` runs microtasks so a promise which is already settled finishes right away.
+			Phase2Waiter::Wait(promise, std::move(self), std::move(info));
+			IsolateEnvironment::GetCurrent()->TaskEpilogue();
+			return;
+		}
 		IsolateEnvironment::GetCurrent()->TaskEpilogue();
 		auto holder = info->remotes.GetIsolateHolder();
 		holder->ScheduleTask(std::make_unique<Phase3Success>(std::move(self), std::move(info)), false, true);
 	}, [ this ](unique_ptr<ExternalCopy> error) {
-
+		if (!info) {
+			// The task was handed off to `Phase2Waiter` which will take care of the first isolate
+			return;
+		}
 		// Schedule a task to enter the first isolate so we can throw the error at the promise
 		auto holder = info->remotes.GetIsolateHolder();
 		holder->ScheduleTask(std::make_unique<Phase3Failure>(std::move(self), std::move(info), std::move(error)), false, true);
 	});
 }
 
+/**
+ * Phase3Success & Phase3Failure implementation
+ */
+ThreePhaseTask::Phase3Success::Phase3Success(unique_ptr<ThreePhaseTask> self, unique_ptr<CalleeInfo> info) :
+	self(std::move(self)),
+	info(std::move(info)) {}
+
+void ThreePhaseTask::Phase3Success::Run() {
+	Isolate* isolate = Isolate::GetCurrent();
+	auto context_local = info->remotes.Deref<1>();
+	Context::Scope context_scope(context_local);
+	auto promise_local = info->remotes.Deref<0>();
+	CallbackScope callback_scope(info->async, promise_local);
+	FunctorRunners::RunCatchValue([&]() {
+		// Final callback
+		Unmaybe(promise_local->Resolve(context_local, self->Phase3()));
+	}, [&](Local<Value> error) {
+		// Error was thrown
+		if (error->IsObject()) {
+			StackTraceHolder::AttachStack(error.As<Object>(), info->remotes.Deref<2>());
+		}
+		Unmaybe(promise_local->Reject(context_local, error));
+	});
+	isolate->RunMicrotasks();
+}
+
+ThreePhaseTask::Phase3Failure::Phase3Failure(unique_ptr<ThreePhaseTask> self, unique_ptr<CalleeInfo> info, unique_ptr<ExternalCopy> error) :
+	self(std::move(self)),
+	info(std::move(info)),
+	error(std::move(error)) {}
+
+void ThreePhaseTask::Phase3Failure::Run() {
+	// Revive our persistent handles
+	Isolate* isolate = Isolate::GetCurrent();
+	auto context_local = info->remotes.Deref<1>();
+	Context::Scope context_scope(context_local);
+	auto promise_local = info->remotes.Deref<0>();
+	CallbackScope callback_scope(info->async, promise_local);
+	Local<Value> rejection;
+	if (error) {
+		rejection = error->CopyInto();
+	} else {
+		rejection = Exception::Error(v8_string("An exception was thrown. Sorry I don't know more."));
+	}
+	if (rejection->IsObject()) {
+		StackTraceHolder::ChainStack(rejection.As<Object>(), info->remotes.Deref<2>());
+	}
+	// If Reject fails then I think that's bad..
+	Unmaybe(promise_local->Reject(context_local, rejection));
+	isolate->RunMicrotasks();
+}
+
+/**
+ * Phase2Waiter implementation
+ */
+ThreePhaseTask::Phase2Waiter::Phase2Waiter(unique_ptr<ThreePhaseTask> self, unique_ptr<CalleeInfo> info) :
+	self(std::move(self)),
+	info(std::move(info)) {}
+
+ThreePhaseTask::Phase2Waiter::~Phase2Waiter() {
+	holder.Reset();
+	if (!did_settle) {
+		// The promise can never settle now
+		auto isolate_holder = info->remotes.GetIsolateHolder();
+		auto error = std::make_unique<ExternalCopyError>(ExternalCopyError::ErrorType::Error, "Isolate is disposed or the promise will never settle");
+		isolate_holder->ScheduleTask(std::make_unique<Phase3Failure>(std::move(self), std::move(info), std::move(error)), false, true);
+	}
+}
+
+void ThreePhaseTask::Phase2Waiter::Wait(Local<Promise> promise, unique_ptr<ThreePhaseTask> self, unique_ptr<CalleeInfo> info) {
+	Isolate* isolate = Isolate::GetCurrent();
+	IsolateEnvironment& env = *IsolateEnvironment::GetCurrent();
+	Local<Context> context = env.DefaultContext();
+	auto waiter = new Phase2Waiter(std::move(self), std::move(info));
+	// Only the handlers reference `holder`, and only one of them will ever run
+	Local<Array> holder = Array::New(isolate, 1);
+	Unmaybe(holder->Set(context, 0, External::New(isolate, waiter)));
+	waiter->holder.Reset(isolate, holder);
+	waiter->holder.SetWeak(reinterpret_cast<void*>(waiter), &WeakCallbackV8, WeakCallbackType::kParameter);
+	env.AddWeakCallback(&waiter->holder, WeakCallback, waiter);
+	Local<Function> fulfilled = Unmaybe(Function::New(context, Fulfilled, holder));
+	Local<Function> rejected = Unmaybe(Function::New(context, Rejected, holder));
+	Unmaybe(promise->Then(context, fulfilled, rejected));
+}
+
+void ThreePhaseTask::Phase2Waiter::Fulfilled(const FunctionCallbackInfo<Value>& info) {
+	Settled(info, false);
+}
+
+void ThreePhaseTask::Phase2Waiter::Rejected(const FunctionCallbackInfo<Value>& info) {
+	Settled(info, true);
+}
+
+void ThreePhaseTask::Phase2Waiter::Settled(const FunctionCallbackInfo<Value>& info, bool rejected) {
+	IsolateEnvironment& env = *IsolateEnvironment::GetCurrent();
+	Local<Context> context = env.DefaultContext();
+	Local<Value> external = Unmaybe(info.Data().As<Array>()->Get(context, 0));
+	unique_ptr<Phase2Waiter> waiter(static_cast<Phase2Waiter*>(external.As<External>()->Value()));
+	env.RemoveWeakCallback(&waiter->holder);
+	waiter->did_settle = true;
+	Local<Value> value = info[0];
+	auto holder = waiter->info->remotes.GetIsolateHolder();
+	FunctorRunners::RunCatchExternal(context, [ &waiter, &holder, value, rejected ]() {
+		waiter->self->Phase2Settled(value, rejected);
+		holder->ScheduleTask(std::make_unique<Phase3Success>(std::move(waiter->self), std::move(waiter->info)), false, true);
+	}, [ &waiter, &holder ](unique_ptr<ExternalCopy> error) {
+		holder->ScheduleTask(std::make_unique<Phase3Failure>(std::move(waiter->self), std::move(waiter->info), std::move(error)), false, true);
+	});
+}
+
+void ThreePhaseTask::Phase2Waiter::WeakCallbackV8(const WeakCallbackInfo<void>& info) {
+	// Nothing but resetting the handle is allowed in the first pass. The waiter stays registered with
+	// the environment so it's still cleaned up if the isolate is disposed before the second pass.
+	static_cast<Phase2Waiter*>(info.GetParameter())->holder.Reset();
+	info.SetSecondPassCallback(WeakCallbackSecondPass);
+}
+
+void ThreePhaseTask::Phase2Waiter::WeakCallbackSecondPass(const WeakCallbackInfo<void>& info) {
+	WeakCallback(info.GetParameter());
+}
+
+void ThreePhaseTask::Phase2Waiter::WeakCallback(void* param) {
+	auto waiter = static_cast<Phase2Waiter*>(param);
+	IsolateEnvironment::GetCurrent()->RemoveWeakCallback(&waiter->holder);
+	delete waiter;
+}
+
 /**
  * Phase2RunnerIgnored implementation
  */
@@ -221,15 +288,13 @@ Local<Value> ThreePhaseTask::RunSync(IsolateHolder& second_isolate, bool allow_a
 
 			// Helper function which flushes handle tasks
 			auto run_handle_tasks = [](IsolateEnvironment& env) {
-				std::queue<std::unique_ptr<Runnable>> handle_tasks;
-				{
-					IsolateEnvironment::Scheduler::Lock scheduler_lock(env.scheduler);
-					handle_tasks = scheduler_lock.TakeHandleTasks();
-				}
+				env.handle_disposer->Flush();
+				auto handle_tasks = env.scheduler.TakeHandleTasks();
 				while (!handle_tasks.empty()) {
 					handle_tasks.front()->Run();
 					handle_tasks.pop();
 				}
+				env.FlushContextDisposals();
 			};
 
 			// This is the simple sync runner case
@@ -328,6 +393,8 @@ Local<Value> ThreePhaseTask::RunSync(IsolateHolder& second_isolate, bool allow_a
 				IsolateEnvironment::Executor::Unlock unlocker(env);
 				// Run it and sleep
 				second_isolate.ScheduleTask(std::make_unique<AsyncRunner>(*this, wait, allow_async, error), false, true);
+				// The default isolate may need a pool thread to finish, so this one is given up for now
+				thread_pool_t::blocking_t blocking;
 				wait.Wait();
 			}
 
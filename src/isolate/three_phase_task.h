@@ -10,6 +10,8 @@
 
 namespace ivm {
 
+class ExternalCopy;
+
 /**
  * Most operations in this library can be decomposed into three phases.
  *
@@ -65,6 +67,49 @@ class ThreePhaseTask {
 			void Run() final;
 		};
 
+		/**
+		 * Runs phase 3 in the first isolate after phase 2 succeeded, or rejects the promise if it
+		 * failed
+		 */
+		struct Phase3Success : public Runnable {
+			std::unique_ptr<ThreePhaseTask> self;
+			std::unique_ptr<CalleeInfo> info;
+			Phase3Success(std::unique_ptr<ThreePhaseTask> self, std::unique_ptr<CalleeInfo> info);
+			void Run() final;
+		};
+
+		struct Phase3Failure : public Runnable {
+			std::unique_ptr<ThreePhaseTask> self;
+			std::unique_ptr<CalleeInfo> info;
+			std::unique_ptr<ExternalCopy> error;
+			Phase3Failure(std::unique_ptr<ThreePhaseTask> self, std::unique_ptr<CalleeInfo> info, std::unique_ptr<ExternalCopy> error);
+			void Run() final;
+		};
+
+		/**
+		 * Owns a task while its phase 2 waits on a promise in the second isolate. The promise handlers
+		 * hold this weakly, so if they're collected without running, or the isolate is disposed, the
+		 * task is dropped and the first isolate gets an error instead.
+		 */
+		struct Phase2Waiter {
+			std::unique_ptr<ThreePhaseTask> self;
+			std::unique_ptr<CalleeInfo> info;
+			v8::Persistent<v8::Object> holder;
+			bool did_settle = false;
+
+			Phase2Waiter(std::unique_ptr<ThreePhaseTask> self, std::unique_ptr<CalleeInfo> info);
+			Phase2Waiter(const Phase2Waiter&) = delete;
+			Phase2Waiter& operator= (const Phase2Waiter&) = delete;
+			~Phase2Waiter();
+			static void Wait(v8::Local<v8::Promise> promise, std::unique_ptr<ThreePhaseTask> self, std::unique_ptr<CalleeInfo> info);
+			static void Fulfilled(const v8::FunctionCallbackInfo<v8::Value>& info);
+			static void Rejected(const v8::FunctionCallbackInfo<v8::Value>& info);
+			static void Settled(const v8::FunctionCallbackInfo<v8::Value>& info, bool rejected);
+			static void WeakCallbackV8(const v8::WeakCallbackInfo<void>& info);
+			static void WeakCallbackSecondPass(const v8::WeakCallbackInfo<void>& info);
+			static void WeakCallback(void* param);
+		};
+
 		/**
 		 * Class which manages running async phase 2 in ignored mode (ie no phase 3)
 		 */
@@ -88,6 +133,17 @@ class ThreePhaseTask {
 			return false;
 		}
 
+		/**
+		 * Used instead of `Phase2()` when the task was started with a promise returned. A task may return
+		 * a promise here to delay phase 3 until the promise settles, at which point `Phase2Settled()` is
+		 * called in the second isolate. No thread is held while waiting.
+		 */
+		virtual v8::Local<v8::Promise> Phase2Deferred() {
+			Phase2();
+			return {};
+		}
+		virtual void Phase2Settled(v8::Local<v8::Value> /*value*/, bool /*rejected*/) {}
+
 		virtual v8::Local<v8::Value> Phase3() = 0;
 
 		template <int async, typename T, typename ...Args>
@@ -4,10 +4,12 @@
 #include "external_copy_handle.h"
 #include "script_handle.h"
 #include "module_handle.h"
+#include "script_origin.h"
 #include "session_handle.h"
 #include "isolate/allocator.h"
 #include "isolate/functor_runners.h"
 #include "isolate/platform_delegate.h"
+#include "isolate/pool.h"
 #include "isolate/remote_handle.h"
 #include "isolate/three_phase_task.h"
 #include "isolate/v8_version.h"
@@ -18,108 +20,6 @@ using std::unique_ptr;
 
 namespace ivm {
 
-/**
- * Parses script origin information from an option object and returns a non-v8 holder for the
- * information which can then be converted to a ScriptOrigin, perhaps in a different isolate from
- * the one it was read in.
- */
-class ScriptOriginHolder {
-	private:
-		std::string filename;
-		int columnOffset;
-		int lineOffset;
-		bool isModule;
-	public:
-		explicit ScriptOriginHolder(MaybeLocal<Object> maybe_options, bool is_module = false)
-			:
-				filename("<isolated-vm>"),
-				columnOffset(0),
-				lineOffset(0),
-				isModule(is_module)
-		{
-			Local<Object> options;
-			if (maybe_options.ToLocal(&options)) {
-				Isolate* isolate = Isolate::GetCurrent();
-				Local<Context> context = isolate->GetCurrentContext();
-				Local<Value> filename = Unmaybe(options->Get(context, v8_string("filename")));
-				if (!filename->IsUndefined()) {
-					if (!filename->IsString()) {
-						throw js_type_error("`filename` must be a string");
-					}
-					this->filename = *String::Utf8Value{isolate, filename.As<String>()};
-				}
-				Local<Value> columnOffset = Unmaybe(options->Get(context, v8_string("columnOffset")));
-				if (!columnOffset->IsUndefined()) {
-					if (!columnOffset->IsInt32()) {
-						throw js_type_error("`columnOffset` must be an integer");
-					}
-					this->columnOffset = columnOffset.As<Int32>()->Value();
-				}
-				Local<Value> lineOffset = Unmaybe(options->Get(context, v8_string("lineOffset")));
-				if (!lineOffset->IsUndefined()) {
-					if (!lineOffset->IsInt32()) {
-						throw js_type_error("`lineOffset` must be an integer");
-					}
-					this->lineOffset = lineOffset.As<Int32>()->Value();
-				}
-			}
-		}
-
-		ScriptOrigin ToScriptOrigin() {
-			Isolate* isolate = Isolate::GetCurrent();
-			v8::Local<v8::Integer> integer;
-			v8::Local<v8::Boolean> boolean;
-			v8::Local<v8::String> string;
-			return {
-				v8_string(filename.c_str()), // resource_name,
-				Integer::New(isolate, columnOffset), // resource_line_offset
-				Integer::New(isolate, lineOffset), // resource_column_offset
-				boolean, // resource_is_shared_cross_origin
-				integer, // script_id
-				string, // source_map_url
-				boolean, // resource_is_opaque
-				boolean, // is_wasm
-				Boolean::New(isolate, this->isModule)
-			};
-		}
-};
-
-/**
- * Run a function and annotate the exception with source / line number if it throws. Note that this
- * only handles errors that live inside v8, not C++ errors
- */
-template <typename T, typename F>
-T RunWithAnnotatedErrors(F&& fn) {
-	Isolate* isolate = Isolate::GetCurrent();
-	TryCatch try_catch(isolate);
-	try {
-		return fn();
-	} catch (const js_error_message& cc_error) {
-		throw std::logic_error("Invalid error thrown by RunWithAnnotatedErrors");
-	} catch (const js_runtime_error& cc_error) {
-		try {
-			assert(try_catch.HasCaught());
-			Local<Context> context = isolate->GetCurrentContext();
-			Local<Value> error = try_catch.Exception();
-			Local<Message> message = try_catch.Message();
-			assert(error->IsObject());
-			int linenum = Unmaybe(message->GetLineNumber(context));
-			int start_column = Unmaybe(message->GetStartColumn(context));
-			std::string decorator =
-				std::string{*String::Utf8Value{isolate, message->GetScriptResourceName()}} +
-				":" + std::to_string(linenum) +
-				":" + std::to_string(start_column + 1);
-			std::string message_str = *String::Utf8Value{isolate, Unmaybe(error.As<Object>()->Get(context, v8_symbol("message")))};
-			Unmaybe(error.As<Object>()->Set(context, v8_symbol("message"), v8_string((message_str + " [" + decorator + "]").c_str())));
-			isolate->ThrowException(error);
-			throw js_runtime_error();
-		} catch (const js_runtime_error& cc_error) {
-			try_catch.ReThrow();
-			throw js_runtime_error();
-		}
-	}
-}
-
 /**
  * IsolateHandle implementation
  */
@@ -134,7 +34,10 @@ IsolateHandle::IsolateHandle(shared_ptr<IsolateHolder> isolate) : isolate(std::m
 Local<FunctionTemplate> IsolateHandle::Definition() {
 	return Inherit<TransferableHandle>(MakeClass(
 	 "Isolate", ParameterizeCtor<decltype(&New), &New>(),
+		"create", ParameterizeStatic<decltype(&Create), &Create>(),
 		"createSnapshot", ParameterizeStatic<decltype(&CreateSnapshot), &CreateSnapshot>(),
+		"setThreadPoolSize", ParameterizeStatic<decltype(&SetThreadPoolSize), &SetThreadPoolSize>(),
+		"setPoolSize", ParameterizeStatic<decltype(&SetPoolSize), &SetPoolSize>(),
 		"compileScript", Parameterize<decltype(&IsolateHandle::CompileScript<1>), &IsolateHandle::CompileScript<1>>(),
 		"compileScriptSync", Parameterize<decltype(&IsolateHandle::CompileScript<0>), &IsolateHandle::CompileScript<0>>(),
 		"compileModule", Parameterize<decltype(&IsolateHandle::CompileModule<1>), &IsolateHandle::CompileModule<1>>(),
@@ -153,61 +56,250 @@ Local<FunctionTemplate> IsolateHandle::Definition() {
 }
 
 /**
- * Create a new Isolate. It all starts here!
+ * Options shared by `new Isolate()` and `Isolate.setPoolSize()`
  */
-unique_ptr<ClassHandle> IsolateHandle::New(MaybeLocal<Object> maybe_options) {
-	Local<Context> context = Isolate::GetCurrent()->GetCurrentContext();
+static void ParseIsolateOptions(
+	Local<Context> context, Local<Object> options,
+	size_t& memory_limit, shared_ptr<void>& snapshot_blob, size_t& snapshot_blob_length
+) {
+	// Check memory limits
+	Local<Value> maybe_memory_limit = Unmaybe(options->Get(context, v8_symbol("memoryLimit")));
+	if (!maybe_memory_limit->IsUndefined()) {
+		if (!maybe_memory_limit->IsNumber()) {
+			throw js_generic_error("`memoryLimit` must be a number");
+		}
+		memory_limit = (size_t)maybe_memory_limit.As<Number>()->Value();
+		if (memory_limit < 8) {
+			throw js_generic_error("`memoryLimit` must be at least 8");
+		}
+	}
+
+	// Set snapshot
+	Local<Value> snapshot_handle = Unmaybe(options->Get(context, v8_symbol("snapshot")));
+	if (!snapshot_handle->IsUndefined()) {
+		if (snapshot_handle->IsObject()) {
+			auto copy_handle = ClassHandle::Unwrap<ExternalCopyHandle>(snapshot_handle.As<Object>());
+			if (copy_handle != nullptr) {
+				ExternalCopyArrayBuffer* copy_ptr = dynamic_cast<ExternalCopyArrayBuffer*>(copy_handle->GetValue().get());
+				if (copy_ptr != nullptr) {
+					snapshot_blob = copy_ptr->Acquire();
+					snapshot_blob_length = copy_ptr->Length();
+				}
+			}
+		}
+		if (!snapshot_blob) {
+			throw js_type_error("`snapshot` must be an ExternalCopy to ArrayBuffer");
+		}
+	}
+}
+
+/**
+ * Options for `new Isolate()` and `Isolate.create()`
+ */
+struct IsolateOptions {
 	shared_ptr<void> snapshot_blob;
 	size_t snapshot_blob_length = 0;
 	size_t memory_limit = 128;
 	bool inspector = false;
+	size_t context_pool_size = 0;
+	thread_pool_t* thread_pool_group = nullptr;
+	shared_ptr<cpu_quota_t> cpu_quota;
+	shared_ptr<code_cache_store_t> code_cache_store;
 
-	// Parse options
-	Local<Object> options;
-	if (maybe_options.ToLocal(&options)) {
+	explicit IsolateOptions(MaybeLocal<Object> maybe_options) {
+		Local<Context> context = Isolate::GetCurrent()->GetCurrentContext();
+		Local<Object> options;
+		if (!maybe_options.ToLocal(&options)) {
+			return;
+		}
+		ParseIsolateOptions(context, options, memory_limit, snapshot_blob, snapshot_blob_length);
+
+		// Check inspector flag
+		inspector = IsOptionSet(context, options, "inspector");
 
-		// Check memory limits
-		Local<Value> maybe_memory_limit = Unmaybe(options->Get(context, v8_symbol("memoryLimit")));
-		if (!maybe_memory_limit->IsUndefined()) {
-			if (!maybe_memory_limit->IsNumber()) {
-				throw js_generic_error("`memoryLimit` must be a number");
+		// Spare contexts
+		Local<Value> context_pool_handle = Unmaybe(options->Get(context, v8_symbol("contextPoolSize")));
+		if (!context_pool_handle->IsUndefined()) {
+			if (!context_pool_handle->IsUint32()) {
+				throw js_type_error("`contextPoolSize` must be a non-negative integer");
 			}
-			memory_limit = (size_t)maybe_memory_limit.As<Number>()->Value();
-			if (memory_limit < 8) {
-				throw js_generic_error("`memoryLimit` must be at least 8");
+			context_pool_size = context_pool_handle.As<Uint32>()->Value();
+		}
+
+		// Pin to thread pool group
+		Local<Value> thread_pool_handle = Unmaybe(options->Get(context, v8_symbol("threadPool")));
+		if (!thread_pool_handle->IsUndefined()) {
+			if (!thread_pool_handle->IsString()) {
+				throw js_type_error("`threadPool` must be a string");
+			}
+			std::string name = *String::Utf8Value{Isolate::GetCurrent(), thread_pool_handle};
+			thread_pool_group = IsolateEnvironment::Scheduler::GetThreadPoolGroup(name);
+			if (thread_pool_group == nullptr) {
+				throw js_generic_error("Thread pool group `"+ name+ "` does not exist");
 			}
 		}
 
-		// Set snapshot
-		Local<Value> snapshot_handle = Unmaybe(options->Get(context, v8_symbol("snapshot")));
-		if (!snapshot_handle->IsUndefined()) {
-			if (snapshot_handle->IsObject()) {
-				auto copy_handle = ClassHandle::Unwrap<ExternalCopyHandle>(snapshot_handle.As<Object>());
-				if (copy_handle != nullptr) {
-					ExternalCopyArrayBuffer* copy_ptr = dynamic_cast<ExternalCopyArrayBuffer*>(copy_handle->GetValue().get());
-					if (copy_ptr != nullptr) {
-						snapshot_blob = copy_ptr->Acquire();
-						snapshot_blob_length = copy_ptr->Length();
-					}
+		// CPU quota
+		Local<Value> cpu_quota_handle = Unmaybe(options->Get(context, v8_symbol("cpuQuota")));
+		if (!cpu_quota_handle->IsUndefined()) {
+			if (!cpu_quota_handle->IsObject()) {
+				throw js_type_error("`cpuQuota` must be an object");
+			}
+			Local<Object> cpu_quota_options = cpu_quota_handle.As<Object>();
+			Local<Value> limit_handle = Unmaybe(cpu_quota_options->Get(context, v8_symbol("limit")));
+			if (!limit_handle->IsUint32() || limit_handle.As<Uint32>()->Value() == 0) {
+				throw js_type_error("`cpuQuota.limit` must be a positive integer");
+			}
+			auto limit = std::chrono::milliseconds{limit_handle.As<Uint32>()->Value()};
+			auto window = std::chrono::milliseconds{1000};
+			Local<Value> window_handle = Unmaybe(cpu_quota_options->Get(context, v8_symbol("window")));
+			if (!window_handle->IsUndefined()) {
+				if (!window_handle->IsUint32() || window_handle.As<Uint32>()->Value() == 0) {
+					throw js_type_error("`cpuQuota.window` must be a positive integer");
 				}
+				window = std::chrono::milliseconds{window_handle.As<Uint32>()->Value()};
 			}
-			if (!snapshot_blob) {
-				throw js_type_error("`snapshot` must be an ExternalCopy to ArrayBuffer");
+			Local<Value> group_handle = Unmaybe(cpu_quota_options->Get(context, v8_symbol("group")));
+			if (group_handle->IsUndefined()) {
+				cpu_quota = std::make_shared<cpu_quota_t>(limit, window);
+			} else if (group_handle->IsString()) {
+				cpu_quota = cpu_quota_t::group(*String::Utf8Value{Isolate::GetCurrent(), group_handle}, limit, window);
+			} else {
+				throw js_type_error("`cpuQuota.group` must be a string");
 			}
 		}
 
-		// Check inspector flag
-		inspector = IsOptionSet(context, options, "inspector");
+		// On-disk code cache
+		Local<Value> code_cache_handle = Unmaybe(options->Get(context, v8_symbol("codeCache")));
+		if (!code_cache_handle->IsUndefined()) {
+			if (!code_cache_handle->IsString() || code_cache_handle.As<String>()->Length() == 0) {
+				throw js_type_error("`codeCache` must be a directory name");
+			}
+			code_cache_store = std::make_shared<code_cache_store_t>(*String::Utf8Value{Isolate::GetCurrent(), code_cache_handle});
+		}
+	}
+
+	// Returns a prebuilt isolate if there's a pool for these options
+	shared_ptr<IsolateHolder> TakeFromPool() const {
+		return IsolatePool::Take(memory_limit, snapshot_blob.get());
+	}
+
+	shared_ptr<IsolateHolder> Build() const {
+		return IsolateEnvironment::New(memory_limit, snapshot_blob, snapshot_blob_length);
 	}
 
-	// Return isolate handle
-	auto isolate = IsolateEnvironment::New(memory_limit, std::move(snapshot_blob), snapshot_blob_length);
-	if (inspector) {
-		isolate->GetIsolate()->EnableInspectorAgent();
+	// Applies the options which don't go into `IsolateCtor`
+	void Apply(IsolateEnvironment& env) const {
+		if (inspector) {
+			env.EnableInspectorAgent();
+		}
+		if (thread_pool_group != nullptr) {
+			env.SetThreadPoolGroup(thread_pool_group);
+		}
+		if (context_pool_size != 0) {
+			env.SetContextPoolSize(context_pool_size);
+		}
+		if (cpu_quota) {
+			env.SetCpuQuota(cpu_quota);
+		}
+		if (code_cache_store) {
+			env.SetCodeCacheStore(code_cache_store);
+		}
 	}
+};
+
+/**
+ * Create a new Isolate. It all starts here!
+ */
+unique_ptr<ClassHandle> IsolateHandle::New(MaybeLocal<Object> maybe_options) {
+	IsolateOptions options{maybe_options};
+	auto isolate = options.TakeFromPool();
+	if (!isolate) {
+		isolate = options.Build();
+	}
+	options.Apply(*isolate->GetIsolate());
 	return std::make_unique<IsolateHandle>(isolate);
 }
 
+/**
+ * Same as `new Isolate()` except `Isolate::New` and snapshot deserialization run on the thread pool
+ * instead of blocking the calling thread.
+ */
+struct CreateIsolateTask : public Runnable {
+	IsolateOptions options;
+	RemoteTuple<Promise::Resolver, Context> remotes;
+	shared_ptr<IsolateHolder> isolate;
+	node::async_context async { 0, 0 };
+	bool is_default;
+
+	CreateIsolateTask(IsolateOptions options, Local<Promise::Resolver> resolver, Local<Context> context) :
+			options(std::move(options)), remotes(resolver, context), is_default(IsolateEnvironment::GetCurrent()->IsDefault()) {
+		if (is_default) {
+			// Keep node alive until the isolate is ready
+			IsolateEnvironment::Scheduler::IncrementUvRef();
+			async = node::EmitAsyncInit(Isolate::GetCurrent(), resolver->GetPromise(), v8_symbol("isolated-vm"));
+		}
+	}
+	CreateIsolateTask(const CreateIsolateTask&) = delete;
+	CreateIsolateTask& operator= (const CreateIsolateTask&) = delete;
+
+	~CreateIsolateTask() final {
+		if (is_default) {
+			IsolateEnvironment::Scheduler::DecrementUvRef();
+		}
+	}
+
+	static void Entry(bool /* pool_thread */, void* param) {
+		unique_ptr<CreateIsolateTask> self(static_cast<CreateIsolateTask*>(param));
+		self->isolate = self->options.Build();
+		// Resolve the promise back in the calling isolate
+		IsolateHolder* holder = self->remotes.GetIsolateHolder();
+		holder->ScheduleTask(std::move(self), false, true);
+	}
+
+	void Run() final {
+		Isolate* calling_isolate = Isolate::GetCurrent();
+		auto context = remotes.Deref<1>();
+		Context::Scope context_scope(context);
+		auto resolver = remotes.Deref<0>();
+		{
+			unique_ptr<node::CallbackScope> callback_scope;
+			if (is_default) {
+				callback_scope = std::make_unique<node::CallbackScope>(calling_isolate, resolver, async);
+			}
+			FunctorRunners::RunCatchValue([&]() {
+				options.Apply(*isolate->GetIsolate());
+				Unmaybe(resolver->Resolve(context, ClassHandle::NewInstance<IsolateHandle>(isolate)));
+			}, [&](Local<Value> error) {
+				Unmaybe(resolver->Reject(context, error));
+			});
+		}
+		if (is_default) {
+			node::EmitAsyncDestroy(calling_isolate, async);
+		}
+		calling_isolate->RunMicrotasks();
+	}
+};
+
+Local<Value> IsolateHandle::Create(MaybeLocal<Object> maybe_options) {
+	IsolateOptions options{maybe_options};
+	Local<Context> context = Isolate::GetCurrent()->GetCurrentContext();
+	Local<Promise::Resolver> resolver = Unmaybe(Promise::Resolver::New(context));
+
+	// Prebuilt isolates are handed out immediately
+	auto isolate = options.TakeFromPool();
+	if (isolate) {
+		options.Apply(*isolate->GetIsolate());
+		Unmaybe(resolver->Resolve(context, ClassHandle::NewInstance<IsolateHandle>(isolate)));
+		return resolver->GetPromise();
+	}
+
+	static thread_pool_t::affinity_t affinity;
+	auto task = std::make_unique<CreateIsolateTask>(std::move(options), resolver, context);
+	IsolateEnvironment::Scheduler::RunInThreadPool(affinity, CreateIsolateTask::Entry, task.release());
+	return resolver->GetPromise();
+}
+
 unique_ptr<Transferable> IsolateHandle::TransferOut() {
 	return std::make_unique<IsolateHandleTransferable>(isolate);
 }
@@ -253,7 +345,7 @@ struct CreateContextRunner : public ThreePhaseTask {
 								IsolateEnvironment::GetCurrent()->GetInspectorAgent()->ContextDestroyed(context);
 							}
 						}
-						isolate->ContextDisposedNotification();
+						IsolateEnvironment::GetCurrent()->ContextDisposed();
 					}
 				};
 				auto context = unique_ptr<RemoteHandle<Context>>(ptr);
@@ -274,7 +366,7 @@ struct CreateContextRunner : public ThreePhaseTask {
 
 		// Make a new context and setup shared pointers
 		IsolateEnvironment::HeapCheck heap_check{*env, true};
-		Local<Context> context_handle = env->NewContext();
+		Local<Context> context_handle = env->TakeContext();
 		if (enable_inspector) {
 			env->GetInspectorAgent()->ContextCreated(context_handle, "<isolated-vm>");
 		}
@@ -293,6 +385,21 @@ Local<Value> IsolateHandle::CreateContext(MaybeLocal<Object> maybe_options) {
 	return ThreePhaseTask::Run<async, CreateContextRunner>(*isolate, maybe_options);
 }
 
+/**
+ * Writes an entry to a code cache store on the thread pool, so the isolate isn't held up by disk IO
+ */
+struct CodeCacheStoreTask {
+	shared_ptr<code_cache_store_t> store;
+	std::string key;
+	unique_ptr<const ScriptCompiler::CachedData> cached_data;
+
+	static void Entry(bool /* pool_thread */, void* param) {
+		unique_ptr<CodeCacheStoreTask> self(static_cast<CodeCacheStoreTask*>(param));
+		// Failure just means the next isolate compiles from scratch too
+		self->store->store(self->key, self->cached_data->data, self->cached_data->length);
+	}
+};
+
 /**
  * Common compilation logic for modules and scripts
  */
@@ -303,12 +410,16 @@ struct CompileCodeRunner : public ThreePhaseTask {
 	shared_ptr<void> cached_data_in;
 	size_t cached_data_in_size = 0;
 	bool produce_cached_data { false };
+	// Entry in the isolate's code cache store, if there is one and `cachedData` wasn't supplied
+	shared_ptr<code_cache_store_t> code_cache_store;
+	std::string code_cache_key;
+	bool from_code_cache_store { false };
 	// phase 3
 	shared_ptr<ExternalCopyArrayBuffer> cached_data_out;
 	bool supplied_cached_data { false };
 	bool cached_data_rejected { false };
 
-	CompileCodeRunner(const Local<String>& code_handle, const MaybeLocal<Object>& maybe_options, bool as_module) {
+	CompileCodeRunner(const Local<String>& code_handle, const MaybeLocal<Object>& maybe_options, bool as_module, shared_ptr<code_cache_store_t> store) {
 		// Read options
 		script_origin_holder = std::make_unique<ScriptOriginHolder>(maybe_options, as_module);
 		Local<Object> options;
@@ -339,6 +450,22 @@ struct CompileCodeRunner : public ThreePhaseTask {
 
 		// Copy code string
 		code_string = std::make_unique<ExternalCopyString>(code_handle);
+
+		// Look up the code cache store entry here so that hashing and file IO happen on the calling
+		// thread instead of under the isolate's lock
+#if !V8_AT_LEAST(6, 9, 37)
+		if (as_module) {
+			// Module code caches can't be consumed by this version of v8
+			store.reset();
+		}
+#endif
+		if (store && !cached_data_in) {
+			const std::vector<char>& bytes = code_string->Bytes();
+			code_cache_key = code_cache_store_t::key(ScriptCompiler::CachedDataVersionTag(), as_module ? "module" : "script", code_string->IsOneByte(), bytes.data(), bytes.size());
+			cached_data_in = store->load(code_cache_key, cached_data_in_size);
+			from_code_cache_store = static_cast<bool>(cached_data_in);
+			code_cache_store = std::move(store);
+		}
 	}
 
 	// Return ScriptCompiler::Source information, including `cachedData` if provided
@@ -351,16 +478,157 @@ struct CompileCodeRunner : public ThreePhaseTask {
 		}
 		return std::make_unique<ScriptCompiler::Source>(code_inner, script_origin, cached_data.release());
 	}
+
+	// Records whether or not cached data was accepted. Returns true if a new code cache should be
+	// written to the store.
+	bool CheckCachedData(const ScriptCompiler::Source& source) {
+		bool rejected = false;
+		if (cached_data_in) {
+			rejected = source.GetCachedData()->rejected;
+			if (!from_code_cache_store) {
+				supplied_cached_data = true;
+				cached_data_rejected = rejected;
+			}
+			cached_data_in.reset();
+		}
+		return !code_cache_key.empty() && (!from_code_cache_store || rejected);
+	}
+
+	// Hands newly produced cached data to the caller and/or the code cache store
+	void SaveCachedData(unique_ptr<const ScriptCompiler::CachedData> cached_data, bool save_to_store) {
+		assert(cached_data != nullptr);
+		if (produce_cached_data && !supplied_cached_data) {
+			cached_data_out = std::make_shared<ExternalCopyArrayBuffer>((const void*)cached_data->data, cached_data->length);
+		}
+		if (save_to_store) {
+			static thread_pool_t::affinity_t affinity;
+			auto task = std::make_unique<CodeCacheStoreTask>();
+			task->store = code_cache_store;
+			task->key = code_cache_key;
+			task->cached_data = std::move(cached_data);
+			IsolateEnvironment::Scheduler::RunInThreadPool(affinity, CodeCacheStoreTask::Entry, task.release());
+		}
+	}
+};
+
+/**
+ * A script being parsed on the thread pool by v8's streaming compiler. This is owned by the thread
+ * pool job so that it's always destroyed before the isolate is.
+ */
+struct StreamingCompile {
+	/**
+	 * Hands the whole script to v8 in one chunk
+	 */
+	class Stream : public ScriptCompiler::ExternalSourceStream {
+		private:
+			unique_ptr<uint8_t[]> data;
+			size_t length;
+
+		public:
+			explicit Stream(const std::vector<char>& bytes) : data(new uint8_t[bytes.size()]), length(bytes.size()) {
+				std::memcpy(data.get(), bytes.data(), length);
+			}
+
+			size_t GetMoreData(const uint8_t** src) final {
+				if (!data) {
+					return 0;
+				}
+				*src = data.release();
+				return length;
+			}
+	};
+
+	unique_ptr<ScriptCompiler::StreamedSource> source;
+	unique_ptr<ScriptCompiler::ScriptStreamingTask> task;
+	RemoteHandle<Promise::Resolver> resolver;
+
+	StreamingCompile(const ExternalCopyString& code_string, Local<Promise::Resolver> resolver) :
+#if V8_AT_LEAST(7, 4, 0)
+		source(std::make_unique<ScriptCompiler::StreamedSource>(
+			std::make_unique<Stream>(code_string.Bytes()),
+#else
+		source(std::make_unique<ScriptCompiler::StreamedSource>(
+			new Stream(code_string.Bytes()),
+#endif
+			code_string.IsOneByte() ? ScriptCompiler::StreamedSource::ONE_BYTE : ScriptCompiler::StreamedSource::TWO_BYTE
+		)),
+		task(
+#if V8_AT_LEAST(9, 0, 0)
+			ScriptCompiler::StartStreaming(Isolate::GetCurrent(), source.get())
+#else
+			ScriptCompiler::StartStreamingScript(Isolate::GetCurrent(), source.get())
+#endif
+		),
+		resolver(resolver) {}
+};
+
+/**
+ * Runs a streaming compile on the thread pool, and then resolves its promise back in the isolate
+ */
+struct StreamingCompileTask : public Runnable {
+	// Keeps the isolate around until v8 is done parsing
+	shared_ptr<IsolateEnvironment> env;
+	shared_ptr<StreamingCompile> state;
+
+	StreamingCompileTask(shared_ptr<IsolateEnvironment> env, shared_ptr<StreamingCompile> state) :
+		env(std::move(env)), state(std::move(state)) {}
+
+	static void Entry(bool /* pool_thread */, void* param) {
+		unique_ptr<StreamingCompileTask> self(static_cast<StreamingCompileTask*>(param));
+		self->state->task->Run();
+		// If the isolate was disposed in the meantime this task is destroyed right away, so the
+		// reference must outlive `ScheduleTask()`
+		shared_ptr<IsolateEnvironment> env = std::move(self->env);
+		auto holder = self->state->resolver.GetSharedIsolateHolder();
+		holder->ScheduleTask(std::move(self), false, true);
+	}
+
+	void Run() final {
+		Isolate* isolate = Isolate::GetCurrent();
+		IsolateEnvironment& env = *IsolateEnvironment::GetCurrent();
+		Local<Context> context = env.DefaultContext();
+		Context::Scope context_scope(context);
+		Local<Promise::Resolver> resolver = state->resolver.Deref();
+		FunctorRunners::RunCatchValue([&]() {
+			// Whatever was already pending in the isolate runs first, and if that fails the compile is
+			// rejected with the error, same as if it had happened after a synchronous compile
+			env.TaskEpilogue();
+			Unmaybe(resolver->Resolve(context, Undefined(isolate)));
+		}, [&](Local<Value> error) {
+			Unmaybe(resolver->Reject(context, error));
+		});
+		// Runs the handlers which finish the compile
+		isolate->RunMicrotasks();
+	}
 };
 
 /**
  * Compiles a script in this isolate and returns a ScriptHandle
  */
 struct CompileScriptRunner : public CompileCodeRunner {
+	// Sources at least this large are parsed off the isolate's thread when compiled asynchronously.
+	// Smaller scripts aren't worth the trip to the thread pool.
+	static constexpr size_t kStreamingThreshold = 1024 * 1024;
 	shared_ptr<RemoteHandle<UnboundScript>> script;
+	std::weak_ptr<StreamingCompile> streaming;
 
-	CompileScriptRunner(const Local<String>& code_handle, const MaybeLocal<Object>& maybe_options) :
-		CompileCodeRunner(code_handle, maybe_options, false) {}
+	CompileScriptRunner(const Local<String>& code_handle, const MaybeLocal<Object>& maybe_options, shared_ptr<code_cache_store_t> store) :
+		CompileCodeRunner(code_handle, maybe_options, false, std::move(store)) {}
+
+	// Produces cached data for the caller and/or the code cache store, if needed
+	void ProduceCachedData(bool save_to_store) {
+		if (save_to_store || (produce_cached_data && !supplied_cached_data)) {
+			unique_ptr<const ScriptCompiler::CachedData> cached_data // continued next line
+#if V8_AT_LEAST(6, 8, 11)
+			// `code` parameter removed in v8 commit a440efb27
+			{ScriptCompiler::CreateCodeCache(script->Deref())};
+#else
+			// Added in v8 commit dae20b064
+			{ScriptCompiler::CreateCodeCache(script->Deref(), code_string->CopyIntoCheckHeap().As<String>())};
+#endif
+			SaveCachedData(std::move(cached_data), save_to_store);
+		}
+	}
 
 	void Phase2() final {
 		// Compile in second isolate and return UnboundScript persistent
@@ -377,22 +645,58 @@ struct CompileScriptRunner : public CompileCodeRunner {
 		));
 
 		// Check cached data flags
-		if (cached_data_in) {
-			supplied_cached_data = true;
-			cached_data_rejected = source->GetCachedData()->rejected;
-			cached_data_in.reset();
-		} else if (produce_cached_data) {
-			const ScriptCompiler::CachedData* cached_data // continued next line
-#if V8_AT_LEAST(6, 8, 11)
-			// `code` parameter removed in v8 commit a440efb27
-			= ScriptCompiler::CreateCodeCache(script->Deref());
-#else
-			// Added in v8 commit dae20b064
-			= ScriptCompiler::CreateCodeCache(script->Deref(), code_string->CopyIntoCheckHeap().As<String>());
-#endif
-			assert(cached_data != nullptr);
-			cached_data_out = std::make_shared<ExternalCopyArrayBuffer>((void*)cached_data->data, cached_data->length);
+		ProduceCachedData(CheckCachedData(*source));
+		heap_check.Epilogue();
+	}
+
+	Local<Promise> Phase2Deferred() final {
+		// Large scripts without cached data are parsed on the thread pool so the isolate is free to run
+		// other tasks in the meantime. `Phase2Settled()` finishes the compile once parsing is done.
+		auto isolate = IsolateEnvironment::GetCurrent();
+		Context::Scope context_scope(isolate->DefaultContext());
+		if (cached_data_in || code_string->Bytes().size() < kStreamingThreshold) {
+			Phase2();
+			return {};
+		}
+		Local<Promise::Resolver> resolver = Unmaybe(Promise::Resolver::New(isolate->DefaultContext()));
+		auto state = std::make_shared<StreamingCompile>(*code_string, resolver);
+		if (!state->task) {
+			// v8 declined to stream this script
+			state.reset();
+			Phase2();
+			return {};
+		}
+		streaming = state;
+		static thread_pool_t::affinity_t affinity;
+		auto task = std::make_unique<StreamingCompileTask>(IsolateEnvironment::GetCurrentHolder()->GetIsolate(), std::move(state));
+		IsolateEnvironment::Scheduler::RunInThreadPool(affinity, StreamingCompileTask::Entry, task.release());
+		return resolver->GetPromise();
+	}
+
+	void Phase2Settled(Local<Value> value, bool rejected) final {
+		if (rejected) {
+			Isolate::GetCurrent()->ThrowException(value);
+			throw js_runtime_error();
+		}
+		// Parsing is done, compile and bind to the default context
+		auto isolate = IsolateEnvironment::GetCurrent();
+		Local<Context> context = isolate->DefaultContext();
+		Context::Scope context_scope(context);
+		IsolateEnvironment::HeapCheck heap_check{*isolate, true};
+		Local<String> code_inner = code_string->CopyIntoCheckHeap().As<String>();
+		ScriptOrigin script_origin = script_origin_holder->ToScriptOrigin();
+		// `StreamingCompileTask` should still be on the stack, unless its microtasks were cut short
+		auto state = streaming.lock();
+		if (!state) {
+			throw js_generic_error("Script compilation was interrupted");
 		}
+		auto source = state->source.get();
+		script = std::make_shared<RemoteHandle<UnboundScript>>(RunWithAnnotatedErrors<Local<UnboundScript>>(
+			[&context, source, &code_inner, &script_origin]() {
+				return Unmaybe(ScriptCompiler::Compile(context, source, code_inner, script_origin))->GetUnboundScript();
+			}
+		));
+		ProduceCachedData(!code_cache_key.empty());
 		heap_check.Epilogue();
 	}
 
@@ -412,7 +716,8 @@ struct CompileScriptRunner : public CompileCodeRunner {
 
 template <int async>
 Local<Value> IsolateHandle::CompileScript(Local<String> code_handle, MaybeLocal<Object> maybe_options) {
-	return ThreePhaseTask::Run<async, CompileScriptRunner>(*this->isolate, code_handle, maybe_options);
+	auto env = this->isolate->GetIsolate();
+	return ThreePhaseTask::Run<async, CompileScriptRunner>(*this->isolate, code_handle, maybe_options, env ? env->GetCodeCacheStore() : nullptr);
 }
 
 /**
@@ -421,31 +726,41 @@ Local<Value> IsolateHandle::CompileScript(Local<String> code_handle, MaybeLocal<
 struct CompileModuleRunner : public CompileCodeRunner {
 	shared_ptr<ModuleInfo> module_info;
 
-	CompileModuleRunner(const Local<String>& code_handle, const MaybeLocal<Object>& maybe_options) :
-		CompileCodeRunner(code_handle, maybe_options, true) {}
+	CompileModuleRunner(const Local<String>& code_handle, const MaybeLocal<Object>& maybe_options, shared_ptr<code_cache_store_t> store) :
+		CompileCodeRunner(code_handle, maybe_options, true, std::move(store)) {}
 
 	void Phase2() final {
 		auto isolate = IsolateEnvironment::GetCurrent();
 		Context::Scope context_scope(isolate->DefaultContext());
 		IsolateEnvironment::HeapCheck heap_check{*isolate, true};
+#if V8_AT_LEAST(6, 9, 37)
+		// v8 6.8.214 [8ec92f51] can produce cached data for modules, but consuming it wasn't supported
+		// until 6.9.37 [70b5fd3b]
 		auto source = GetCompilerSource();
-		Local<Module> module_handle = Unmaybe(ScriptCompiler::CompileModule(*isolate, source.get()));
+		ScriptCompiler::CompileOptions compile_options = ScriptCompiler::kNoCompileOptions;
+		if (cached_data_in) {
+			compile_options = ScriptCompiler::kConsumeCodeCache;
+		}
+		Local<Module> module_handle = Unmaybe(ScriptCompiler::CompileModule(*isolate, source.get(), compile_options));
 
-		// TODO: v8 6.8.214 [8ec92f51] adds support for producing cached data for modules, but support
-		// for actually consuming the cached data wasn't added until 6.9.37 [70b5fd3b]. This hardcoded
-		// failure should be updated when support lands in nodejs.
+		// Check cached data flags
+		bool save_to_store = CheckCachedData(*source);
+		if (save_to_store || (produce_cached_data && !supplied_cached_data)) {
+			SaveCachedData(
+				unique_ptr<const ScriptCompiler::CachedData>{ScriptCompiler::CreateCodeCache(module_handle->GetUnboundModuleScript())},
+				save_to_store
+			);
+		}
+#else
+		auto source = GetCompilerSource();
+		Local<Module> module_handle = Unmaybe(ScriptCompiler::CompileModule(*isolate, source.get()));
 		if (cached_data_in) {
+			// Module code caches can't be consumed by this version of v8
 			supplied_cached_data = true;
-			// cached_data_rejected = source->GetCachedData()->rejected;
 			cached_data_rejected = true;
 			cached_data_in.reset();
-		} else if (produce_cached_data) {
-			/*
-			ScriptCompiler::CachedData* cached_data = ScriptCompiler::CreateCodeCache(module_handle->GetUnboundModuleScript());
-			assert(cached_data != nullptr);
-			cached_data_out = std::make_shared<ExternalCopyArrayBuffer>((void*)cached_data->data, cached_data->length);
-			*/
 		}
+#endif
 		module_info = std::make_shared<ModuleInfo>(module_handle);
 		heap_check.Epilogue();
 	}
@@ -465,7 +780,8 @@ struct CompileModuleRunner : public CompileCodeRunner {
 
 template <int async>
 Local<Value> IsolateHandle::CompileModule(Local<String> code_handle, MaybeLocal<Object> maybe_options) {
-	return ThreePhaseTask::Run<async, CompileModuleRunner>(*this->isolate, code_handle, maybe_options);
+	auto env = this->isolate->GetIsolate();
+	return ThreePhaseTask::Run<async, CompileModuleRunner>(*this->isolate, code_handle, maybe_options, env ? env->GetCodeCacheStore() : nullptr);
 }
 
 /**
@@ -584,6 +900,50 @@ Local<Value> IsolateHandle::IsDisposedGetter() {
 	return Boolean::New(Isolate::GetCurrent(), !isolate->GetIsolate());
 }
 
+/**
+ * Keep prebuilt isolates around for `new Isolate(options)`
+ */
+Local<Value> IsolateHandle::SetPoolSize(Local<Value> size_handle, MaybeLocal<Object> maybe_options) {
+	Isolate* isolate = Isolate::GetCurrent();
+	if (!size_handle->IsNumber()) {
+		throw js_type_error("`size` must be a number");
+	}
+	double size = size_handle.As<Number>()->Value();
+	if (!(size >= 0)) {
+		throw js_range_error("`size` must not be negative");
+	}
+	shared_ptr<void> snapshot_blob;
+	size_t snapshot_blob_length = 0;
+	size_t memory_limit = 128;
+	Local<Object> options;
+	if (maybe_options.ToLocal(&options)) {
+		ParseIsolateOptions(isolate->GetCurrentContext(), options, memory_limit, snapshot_blob, snapshot_blob_length);
+	}
+	IsolatePool::Resize(static_cast<size_t>(std::min<double>(size, 1024)), memory_limit, std::move(snapshot_blob), snapshot_blob_length);
+	return Undefined(isolate);
+}
+
+/**
+ * Resize the shared isolate thread pool, or a named pool group
+ */
+Local<Value> IsolateHandle::SetThreadPoolSize(Local<Value> size_handle, MaybeLocal<String> maybe_group) {
+	Isolate* isolate = Isolate::GetCurrent();
+	if (!size_handle->IsNumber()) {
+		throw js_type_error("`size` must be a number");
+	}
+	double size = size_handle.As<Number>()->Value();
+	if (!(size >= 1)) {
+		throw js_range_error("`size` must be at least 1");
+	}
+	std::string group;
+	Local<String> group_handle;
+	if (maybe_group.ToLocal(&group_handle)) {
+		group = *String::Utf8Value{isolate, group_handle};
+	}
+	IsolateEnvironment::Scheduler::SetThreadPoolSize(static_cast<size_t>(std::min<double>(size, 1024)), group);
+	return Undefined(isolate);
+}
+
 /**
 * Create a snapshot from some code and return it as an external ArrayBuffer
 */
@@ -24,7 +24,9 @@ class IsolateHandle : public TransferableHandle {
 		explicit IsolateHandle(std::shared_ptr<IsolateHolder> isolate);
 		static v8::Local<v8::FunctionTemplate> Definition();
 		static std::unique_ptr<ClassHandle> New(v8::MaybeLocal<v8::Object> maybe_options);
+		static v8::Local<v8::Value> Create(v8::MaybeLocal<v8::Object> maybe_options);
 		std::unique_ptr<Transferable> TransferOut() final;
+		std::shared_ptr<IsolateHolder> GetIsolateHolder() const { return isolate; }
 
 		template <int async> v8::Local<v8::Value> CreateContext(v8::MaybeLocal<v8::Object> maybe_options);
 		template <int async> v8::Local<v8::Value> CompileScript(v8::Local<v8::String> code_handle, v8::MaybeLocal<v8::Object> maybe_options);
@@ -37,6 +39,8 @@ class IsolateHandle : public TransferableHandle {
 		v8::Local<v8::Value> GetWallTime();
 		v8::Local<v8::Value> GetReferenceCount();
 		v8::Local<v8::Value> IsDisposedGetter();
+		static v8::Local<v8::Value> SetPoolSize(v8::Local<v8::Value> size_handle, v8::MaybeLocal<v8::Object> maybe_options);
+		static v8::Local<v8::Value> SetThreadPoolSize(v8::Local<v8::Value> size_handle, v8::MaybeLocal<v8::String> maybe_group);
 		static v8::Local<v8::Value> CreateSnapshot(v8::Local<v8::Array> script_handles, v8::MaybeLocal<v8::String> warmup_handle);
 };
 
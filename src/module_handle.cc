@@ -383,8 +383,9 @@ struct EvaluateRunner : public ThreePhaseTask {
 	shared_ptr<ModuleInfo> info;
 	std::unique_ptr<Transferable> result;
 	uint32_t timeout;
+	uint32_t cpu_timeout;
 
-	EvaluateRunner(shared_ptr<ModuleInfo> info, uint32_t ms) : info(std::move(info)), timeout(ms) {}
+	EvaluateRunner(shared_ptr<ModuleInfo> info, uint32_t ms, uint32_t cpu_ms) : info(std::move(info)), timeout(ms), cpu_timeout(cpu_ms) {}
 
 	void Phase2() final {
 		Local<Module> mod = info->handle.Deref();
@@ -393,7 +394,7 @@ struct EvaluateRunner : public ThreePhaseTask {
 		}
 		Local<Context> context_local = Deref(*info->context_handle);
 		Context::Scope context_scope(context_local);
-		result = Transferable::OptionalTransferOut(RunWithTimeout(timeout, [&]() { return mod->Evaluate(context_local); }));
+		result = Transferable::OptionalTransferOut(RunWithTimeout(timeout, cpu_timeout, [&]() { return mod->Evaluate(context_local); }));
 		std::lock_guard<std::mutex> lock(info->mutex);
 		info->global_namespace = std::make_shared<RemoteHandle<Value>>(mod->GetModuleNamespace());
 	}
@@ -410,19 +411,14 @@ struct EvaluateRunner : public ThreePhaseTask {
 template <int async>
 Local<Value> ModuleHandle::Evaluate(MaybeLocal<Object> maybe_options) {
 	auto info = GetInfo();
-	Isolate* isolate = Isolate::GetCurrent();
 	uint32_t timeout_ms = 0;
+	uint32_t cpu_timeout_ms = 0;
 	Local<Object> options;
 	if (maybe_options.ToLocal(&options)) {
-		Local<Value> timeout_handle = Unmaybe(options->Get(isolate->GetCurrentContext(), v8_string("timeout")));
-		if (!timeout_handle->IsUndefined()) {
-			if (!timeout_handle->IsUint32()) {
-				throw js_type_error("`timeout` must be integer");
-			}
-			timeout_ms = timeout_handle.As<Uint32>()->Value();
-		}
+		timeout_ms = ReadTimeoutOption(options, "timeout");
+		cpu_timeout_ms = ReadTimeoutOption(options, "cpuTimeout");
 	}
-	return ThreePhaseTask::Run<async, EvaluateRunner>(*info->handle.GetIsolateHolder(), info, timeout_ms);
+	return ThreePhaseTask::Run<async, EvaluateRunner>(*info->handle.GetIsolateHolder(), info, timeout_ms, cpu_timeout_ms);
 }
 
 Local<Value> ModuleHandle::GetNamespace() {
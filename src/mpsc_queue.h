@@ -0,0 +1,100 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <utility>
+
+// This file contains no v8 code and is therefore free from v8's naming conventions
+
+/**
+ * Lock-free queue where any number of threads may push and a consumer takes the whole queue at
+ * once. Pushing is a single CAS onto a linked stack, and `take` swaps the stack out in one atomic
+ * exchange and reverses it back into FIFO order. Nodes are never popped one by one, so there is no
+ * ABA hazard, and it's even safe for more than one thread to call `take`.
+ */
+template <class T>
+class mpsc_queue_t {
+	private:
+		struct node_t {
+			std::unique_ptr<T> value;
+			node_t* next;
+			explicit node_t(std::unique_ptr<T> value) : value(std::move(value)), next(nullptr) {}
+		};
+
+	public:
+		/**
+		 * Tasks taken out of the queue, in the order they were pushed
+		 */
+		class list_t {
+			friend class mpsc_queue_t;
+			private:
+				node_t* head = nullptr;
+				explicit list_t(node_t* head) : head(head) {}
+
+			public:
+				list_t() = default;
+				list_t(const list_t&) = delete;
+				list_t& operator= (const list_t&) = delete;
+				list_t(list_t&& that) noexcept : head(that.head) {
+					that.head = nullptr;
+				}
+				list_t& operator= (list_t&& that) noexcept {
+					std::swap(head, that.head);
+					return *this;
+				}
+				~list_t() {
+					while (!empty()) {
+						pop();
+					}
+				}
+
+				bool empty() const {
+					return head == nullptr;
+				}
+
+				std::unique_ptr<T>& front() {
+					return head->value;
+				}
+
+				void pop() {
+					node_t* node = head;
+					head = node->next;
+					delete node;
+				}
+		};
+
+	private:
+		std::atomic<node_t*> head{nullptr};
+
+	public:
+		mpsc_queue_t() = default;
+		mpsc_queue_t(const mpsc_queue_t&) = delete;
+		mpsc_queue_t& operator= (const mpsc_queue_t&) = delete;
+		~mpsc_queue_t() {
+			take();
+		}
+
+		void push(std::unique_ptr<T> value) {
+			node_t* node = new node_t(std::move(value));
+			node_t* expected = head.load(std::memory_order_relaxed);
+			do {
+				node->next = expected;
+			} while (!head.compare_exchange_weak(expected, node));
+		}
+
+		bool empty() const {
+			return head.load() == nullptr;
+		}
+
+		list_t take() {
+			node_t* node = head.exchange(nullptr);
+			// Reverse LIFO stack into FIFO list
+			node_t* reversed = nullptr;
+			while (node != nullptr) {
+				node_t* next = node->next;
+				node->next = reversed;
+				reversed = node;
+				node = next;
+			}
+			return list_t(reversed);
+		}
+};
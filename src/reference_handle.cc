@@ -69,6 +69,9 @@ Local<FunctionTemplate> ReferenceHandle::Definition() {
 		"applyIgnored", Parameterize<decltype(&ReferenceHandle::Apply<2>), &ReferenceHandle::Apply<2>>(),
 		"applySync", Parameterize<decltype(&ReferenceHandle::Apply<0>), &ReferenceHandle::Apply<0>>(),
 		"applySyncPromise", Parameterize<decltype(&ReferenceHandle::Apply<4>), &ReferenceHandle::Apply<4>>(),
+		"applyBatch", Parameterize<decltype(&ReferenceHandle::ApplyBatch<1>), &ReferenceHandle::ApplyBatch<1>>(),
+		"applyBatchIgnored", Parameterize<decltype(&ReferenceHandle::ApplyBatch<2>), &ReferenceHandle::ApplyBatch<2>>(),
+		"applyBatchSync", Parameterize<decltype(&ReferenceHandle::ApplyBatch<0>), &ReferenceHandle::ApplyBatch<0>>(),
 		"typeof", ParameterizeAccessor<decltype(&ReferenceHandle::TypeOfGetter), &ReferenceHandle::TypeOfGetter>()
 	));
 }
@@ -286,6 +289,24 @@ Local<Value> ReferenceHandle::Set(Local<Value> key_handle, Local<Value> val_hand
 	return ThreePhaseTask::Run<async, SetRunner>(*isolate, *this, key_handle, val_handle, context, reference);
 }
 
+/**
+ * Externalizes an `arguments` array for Apply and ApplyBatch
+ */
+static std::vector<unique_ptr<Transferable>> TransferOutArguments(Local<Array> arguments) {
+	Local<Context> context = Isolate::GetCurrent()->GetCurrentContext();
+	Local<Array> keys = Unmaybe(arguments->GetOwnPropertyNames(context));
+	std::vector<unique_ptr<Transferable>> argv;
+	argv.reserve(keys->Length());
+	for (uint32_t ii = 0; ii < keys->Length(); ++ii) {
+		Local<Uint32> key = Unmaybe(Unmaybe(keys->Get(context, ii))->ToArrayIndex(context));
+		if (key->Value() != ii) {
+			throw js_type_error("Invalid `arguments` array");
+		}
+		argv.push_back(Transferable::TransferOut(Unmaybe(arguments->Get(context, key))));
+	}
+	return argv;
+}
+
 /**
  * Call a function, like Function.prototype.apply
  */
@@ -295,8 +316,10 @@ struct ApplyRunner : public ThreePhaseTask {
 	unique_ptr<Transferable> recv;
 	std::vector<unique_ptr<Transferable>> argv;
 	uint32_t timeout = 0;
+	uint32_t cpu_timeout = 0;
+	bool await_promise = false;
 	unique_ptr<Transferable> ret;
-	// Only used in the AsyncPhase2 case
+	// Only used in the AsyncPhase2 and Phase2Deferred cases
 	shared_ptr<bool> did_finish;
 	IsolateEnvironment::Scheduler::AsyncWait* async_wait = nullptr;
 	unique_ptr<ExternalCopy> async_error;
@@ -319,29 +342,35 @@ struct ApplyRunner : public ThreePhaseTask {
 
 		// Externalize all arguments
 		if (!maybe_arguments.IsEmpty()) {
-			Local<Context> context = Isolate::GetCurrent()->GetCurrentContext();
-			Local<Array> arguments = maybe_arguments.ToLocalChecked();
-			Local<Array> keys = Unmaybe(arguments->GetOwnPropertyNames(context));
-			argv.reserve(keys->Length());
-			for (uint32_t ii = 0; ii < keys->Length(); ++ii) {
-				Local<Uint32> key = Unmaybe(Unmaybe(keys->Get(context, ii))->ToArrayIndex(context));
-				if (key->Value() != ii) {
-					throw js_type_error("Invalid `arguments` array");
-				}
-				argv.push_back(Transferable::TransferOut(Unmaybe(arguments->Get(context, key))));
-			}
+			argv = TransferOutArguments(maybe_arguments.ToLocalChecked());
 		}
 
 		// Get run options
 		Local<Object> options;
 		if (maybe_options.ToLocal(&options)) {
-			Local<Value> timeout_handle = Unmaybe(options->Get(Isolate::GetCurrent()->GetCurrentContext(), v8_string("timeout")));
-			if (!timeout_handle->IsUndefined()) {
-				if (!timeout_handle->IsUint32()) {
-					throw js_type_error("`timeout` must be integer");
-				}
-				timeout = timeout_handle.As<Uint32>()->Value();
+			timeout = ReadTimeoutOption(options, "timeout");
+			cpu_timeout = ReadTimeoutOption(options, "cpuTimeout");
+			await_promise = IsOptionSet(Isolate::GetCurrent()->GetCurrentContext(), options, "promise");
+		}
+	}
+
+	/**
+	 * Stores the settled value of a promise returned from the function
+	 */
+	void Settle(Local<Value> value, bool rejected) {
+		if (rejected) {
+			async_error = ExternalCopy::CopyIfPrimitiveOrError(value);
+			if (!async_error) {
+				async_error = std::make_unique<ExternalCopyError>(ExternalCopyError::ErrorType::Error,
+					"An object was thrown from supplied code within isolated-vm, but that object was not an instance of `Error`."
+				);
 			}
+		} else {
+			FunctorRunners::RunCatchExternal(IsolateEnvironment::GetCurrent()->DefaultContext(), [ this, value ]() {
+				ret = Transferable::TransferOut(value);
+			}, [ this ](unique_ptr<ExternalCopy> error) {
+				async_error = std::move(error);
+			});
 		}
 	}
 
@@ -358,20 +387,9 @@ struct ApplyRunner : public ThreePhaseTask {
 		}
 		ApplyRunner& self = *reinterpret_cast<ApplyRunner*>(info[0].As<External>()->Value());
 		if (info.Length() == 3) {
-			// Resolved
-			FunctorRunners::RunCatchExternal(IsolateEnvironment::GetCurrent()->DefaultContext(), [ &self, &info ]() {
-				self.ret = Transferable::TransferOut(info[2]);
-			}, [ &self ](unique_ptr<ExternalCopy> error) {
-				self.async_error = std::move(error);
-			});
+			self.Settle(info[2], false);
 		} else {
-			// Rejected
-			self.async_error = ExternalCopy::CopyIfPrimitiveOrError(info[3]);
-			if (!self.async_error) {
-				self.async_error = std::make_unique<ExternalCopyError>(ExternalCopyError::ErrorType::Error,
-					"An object was thrown from supplied code within isolated-vm, but that object was not an instance of `Error`."
-				);
-			}
+			self.Settle(info[3], true);
 		}
 		*self.did_finish = true;
 		self.async_wait->Wake();
@@ -414,40 +432,52 @@ struct ApplyRunner : public ThreePhaseTask {
 		return argv_inner;
 	}
 
-	void Phase2() final {
-		// Invoke in the isolate
-		Local<Context> context_handle = ivm::Deref(*context);
-		Context::Scope context_scope(context_handle);
+	/**
+	 * Invokes the function in the target isolate. Caller must enter `context_handle`.
+	 */
+	Local<Value> Invoke(Local<Context> context_handle) {
 		Local<Value> fn = ivm::Deref(*reference);
 		if (!fn->IsFunction()) {
 			throw js_type_error("Reference is not a function");
 		}
 		std::vector<Local<Value>> argv_inner = TransferArguments();
 		Local<Value> recv_inner = recv->TransferIn();
-		ret = Transferable::TransferOut(RunWithTimeout(
-			timeout,
+		return RunWithTimeout(
+			timeout, cpu_timeout,
 			[&fn, &context_handle, &recv_inner, &argv_inner]() {
 				return fn.As<Function>()->Call(context_handle, recv_inner, argv_inner.size(), argv_inner.empty() ? nullptr : &argv_inner[0]);
 			}
-		));
+		);
+	}
+
+	void Phase2() final {
+		// Invoke in the isolate
+		Local<Context> context_handle = ivm::Deref(*context);
+		Context::Scope context_scope(context_handle);
+		ret = Transferable::TransferOut(Invoke(context_handle));
+	}
+
+	Local<Promise> Phase2Deferred() final {
+		// Same as regular `Phase2()` but a returned promise is handed back so phase 3 waits on it
+		Local<Context> context_handle = ivm::Deref(*context);
+		Context::Scope context_scope(context_handle);
+		Local<Value> value = Invoke(context_handle);
+		if (await_promise && value->IsPromise()) {
+			return value.As<Promise>();
+		}
+		ret = Transferable::TransferOut(value);
+		return {};
+	}
+
+	void Phase2Settled(Local<Value> value, bool rejected) final {
+		Settle(value, rejected);
 	}
 
 	bool Phase2Async(IsolateEnvironment::Scheduler::AsyncWait& wait) final {
 		// Same as regular `Phase2()` but if it returns a promise we will wait on it
 		Local<Context> context_handle = ivm::Deref(*context);
 		Context::Scope context_scope(context_handle);
-		Local<Value> fn = ivm::Deref(*reference);
-		if (!fn->IsFunction()) {
-			throw js_type_error("Reference is not a function");
-		}
-		Local<Value> recv_inner = recv->TransferIn();
-		std::vector<Local<Value>> argv_inner = TransferArguments();
-		Local<Value> value = RunWithTimeout(
-			timeout,
-			[&fn, &context_handle, &recv_inner, &argv_inner]() {
-				return fn.As<Function>()->Call(context_handle, recv_inner, argv_inner.size(), argv_inner.empty() ? nullptr : &argv_inner[0]);
-			}
-		);
+		Local<Value> value = Invoke(context_handle);
 		if (value->IsPromise()) {
 			Isolate* isolate = Isolate::GetCurrent();
 			// This is only called from the default isolate, so we don't need an IsolateSpecific
@@ -484,6 +514,106 @@ Local<Value> ReferenceHandle::Apply(MaybeLocal<Value> recv_handle, MaybeLocal<Ar
 	return ThreePhaseTask::Run<async, ApplyRunner>(*isolate, *this, recv_handle, maybe_arguments, maybe_options, context, reference);
 }
 
+/**
+ * Call a function many times in one go. All invocations happen back to back in a single task in the
+ * target isolate, which avoids the scheduling overhead of many small `apply` calls.
+ */
+struct ApplyBatchRunner : public ThreePhaseTask {
+	struct Invocation {
+		unique_ptr<Transferable> recv;
+		std::vector<unique_ptr<Transferable>> argv;
+	};
+	shared_ptr<RemoteHandle<Context>> context;
+	shared_ptr<RemoteHandle<Value>> reference;
+	std::vector<Invocation> invocations;
+	std::vector<unique_ptr<Transferable>> results;
+	uint32_t timeout = 0;
+	uint32_t cpu_timeout = 0;
+
+	ApplyBatchRunner(
+		ReferenceHandle& that,
+		Local<Array> calls,
+		MaybeLocal<Object>& maybe_options,
+		shared_ptr<RemoteHandle<Context>> context,
+		shared_ptr<RemoteHandle<Value>> reference
+	) :	context(std::move(context)), reference(std::move(reference))
+	{
+		that.CheckDisposed();
+
+		// Externalize each [ recv, arguments ] pair
+		Local<Context> context_handle = Isolate::GetCurrent()->GetCurrentContext();
+		uint32_t length = calls->Length();
+		invocations.reserve(length);
+		for (uint32_t ii = 0; ii < length; ++ii) {
+			Local<Value> call_handle = Unmaybe(calls->Get(context_handle, ii));
+			if (!call_handle->IsArray()) {
+				throw js_type_error("Each call must be an array of `[ receiver, arguments ]`");
+			}
+			Local<Array> call = call_handle.As<Array>();
+			Invocation invocation;
+			invocation.recv = Transferable::TransferOut(Unmaybe(call->Get(context_handle, 0)));
+			Local<Value> arguments = Unmaybe(call->Get(context_handle, 1));
+			if (arguments->IsArray()) {
+				invocation.argv = TransferOutArguments(arguments.As<Array>());
+			} else if (!arguments->IsUndefined()) {
+				throw js_type_error("Invalid `arguments` array");
+			}
+			invocations.push_back(std::move(invocation));
+		}
+
+		// Get run options
+		Local<Object> options;
+		if (maybe_options.ToLocal(&options)) {
+			timeout = ReadTimeoutOption(options, "timeout");
+			cpu_timeout = ReadTimeoutOption(options, "cpuTimeout");
+		}
+	}
+
+	void Phase2() final {
+		// Invoke in the isolate
+		Local<Context> context_handle = ivm::Deref(*context);
+		Context::Scope context_scope(context_handle);
+		Local<Value> fn = ivm::Deref(*reference);
+		if (!fn->IsFunction()) {
+			throw js_type_error("Reference is not a function");
+		}
+		// The timeout covers the whole batch. The first exception stops the batch.
+		results.reserve(invocations.size());
+		RunWithTimeout(timeout, cpu_timeout, [ this, &fn, &context_handle ]() -> MaybeLocal<Value> {
+			Isolate* isolate = Isolate::GetCurrent();
+			for (auto& invocation : invocations) {
+				// Each call gets its own scope so a large batch doesn't pile up handles
+				HandleScope handle_scope(isolate);
+				std::vector<Local<Value>> argv_inner;
+				argv_inner.reserve(invocation.argv.size());
+				for (auto& arg : invocation.argv) {
+					argv_inner.emplace_back(arg->TransferIn());
+				}
+				Local<Value> result;
+				if (!fn.As<Function>()->Call(context_handle, invocation.recv->TransferIn(), argv_inner.size(), argv_inner.empty() ? nullptr : &argv_inner[0]).ToLocal(&result)) {
+					return {};
+				}
+				results.emplace_back(Transferable::TransferOut(result));
+			}
+			return Undefined(isolate);
+		});
+	}
+
+	Local<Value> Phase3() final {
+		Isolate* isolate = Isolate::GetCurrent();
+		Local<Context> context = isolate->GetCurrentContext();
+		Local<Array> array = Array::New(isolate, results.size());
+		for (uint32_t ii = 0; ii < results.size(); ++ii) {
+			Unmaybe(array->Set(context, ii, results[ii]->TransferIn()));
+		}
+		return array;
+	}
+};
+template <int async>
+Local<Value> ReferenceHandle::ApplyBatch(Local<Array> calls, MaybeLocal<Object> maybe_options) {
+	return ThreePhaseTask::Run<async, ApplyBatchRunner>(*isolate, *this, calls, maybe_options, context, reference);
+}
+
 /**
  * DereferenceHandle implementation
  */
@@ -18,6 +18,7 @@ class ReferenceHandle : public TransferableHandle {
 	friend struct GetRunner;
 	friend struct SetRunner;
 	friend struct ApplyRunner;
+	friend struct ApplyBatchRunner;
 	public:
 		enum class TypeOf { Null, Undefined, Number, String, Boolean, Object, Function };
 
@@ -70,6 +71,7 @@ class ReferenceHandle : public TransferableHandle {
 			v8::MaybeLocal<v8::Array> maybe_arguments,
 			v8::MaybeLocal<v8::Object> maybe_options
 		);
+		template <int async> v8::Local<v8::Value> ApplyBatch(v8::Local<v8::Array> calls, v8::MaybeLocal<v8::Object> maybe_options);
 };
 
 /**
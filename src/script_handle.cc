@@ -40,6 +40,7 @@ std::unique_ptr<Transferable> ScriptHandle::TransferOut() {
  */
 struct RunRunner /* lol */ : public ThreePhaseTask {
 	uint32_t timeout_ms = 0;
+	uint32_t cpu_timeout_ms = 0;
 	shared_ptr<RemoteHandle<UnboundScript>> script;
 	shared_ptr<RemoteHandle<Context>> context;
 	std::unique_ptr<Transferable> result;
@@ -47,8 +48,9 @@ struct RunRunner /* lol */ : public ThreePhaseTask {
 	RunRunner(
 		shared_ptr<RemoteHandle<UnboundScript>> script,
 		uint32_t timeout_ms,
+		uint32_t cpu_timeout_ms,
 		ContextHandle* context_handle
-	) : timeout_ms(timeout_ms), script(std::move(script)), context(context_handle->context) {
+	) : timeout_ms(timeout_ms), cpu_timeout_ms(cpu_timeout_ms), script(std::move(script)), context(context_handle->context) {
 		// Sanity check
 		context_handle->CheckDisposed();
 		if (this->script->GetIsolateHolder() != context_handle->context->GetIsolateHolder()) {
@@ -62,7 +64,7 @@ struct RunRunner /* lol */ : public ThreePhaseTask {
 		Context::Scope context_scope(context_local);
 		Local<Script> script_handle = Deref(*script)->BindToCurrentContext();
 		result = Transferable::OptionalTransferOut(
-			RunWithTimeout(timeout_ms, [&script_handle, &context_local]() { return script_handle->Run(context_local); })
+			RunWithTimeout(timeout_ms, cpu_timeout_ms, [&script_handle, &context_local]() { return script_handle->Run(context_local); })
 		);
 	}
 
@@ -82,22 +84,18 @@ Local<Value> ScriptHandle::Run(ContextHandle* context_handle, MaybeLocal<Object>
 	Isolate* isolate = Isolate::GetCurrent();
 	bool release = false;
 	uint32_t timeout_ms = 0;
+	uint32_t cpu_timeout_ms = 0;
 	Local<Object> options;
 	if (maybe_options.ToLocal(&options)) {
 		release = IsOptionSet(isolate->GetCurrentContext(), options, "release");
-		Local<Value> timeout_handle = Unmaybe(options->Get(isolate->GetCurrentContext(), v8_string("timeout")));
-		if (!timeout_handle->IsUndefined()) {
-			if (!timeout_handle->IsUint32()) {
-				throw js_type_error("`timeout` must be integer");
-			}
-			timeout_ms = timeout_handle.As<Uint32>()->Value();
-		}
+		timeout_ms = ReadTimeoutOption(options, "timeout");
+		cpu_timeout_ms = ReadTimeoutOption(options, "cpuTimeout");
 	}
 	shared_ptr<RemoteHandle<UnboundScript>> script_ref = script;
 	if (release) {
 		script.reset();
 	}
-	return ThreePhaseTask::Run<async, RunRunner>(*script_ref->GetIsolateHolder(), std::move(script_ref), timeout_ms, context_handle);
+	return ThreePhaseTask::Run<async, RunRunner>(*script_ref->GetIsolateHolder(), std::move(script_ref), timeout_ms, cpu_timeout_ms, context_handle);
 }
 
 Local<Value> ScriptHandle::Release() {
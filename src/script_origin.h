@@ -0,0 +1,112 @@
+#pragma once
+#include <v8.h>
+#include "isolate/util.h"
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+namespace ivm {
+
+/**
+ * Parses script origin information from an option object and returns a non-v8 holder for the
+ * information which can then be converted to a ScriptOrigin, perhaps in a different isolate from
+ * the one it was read in.
+ */
+class ScriptOriginHolder {
+	private:
+		std::string filename;
+		int columnOffset;
+		int lineOffset;
+		bool isModule;
+	public:
+		explicit ScriptOriginHolder(v8::MaybeLocal<v8::Object> maybe_options, bool is_module = false)
+			:
+				filename("<isolated-vm>"),
+				columnOffset(0),
+				lineOffset(0),
+				isModule(is_module)
+		{
+			v8::Local<v8::Object> options;
+			if (maybe_options.ToLocal(&options)) {
+				v8::Isolate* isolate = v8::Isolate::GetCurrent();
+				v8::Local<v8::Context> context = isolate->GetCurrentContext();
+				v8::Local<v8::Value> filename = Unmaybe(options->Get(context, v8_string("filename")));
+				if (!filename->IsUndefined()) {
+					if (!filename->IsString()) {
+						throw js_type_error("`filename` must be a string");
+					}
+					this->filename = *v8::String::Utf8Value{isolate, filename.As<v8::String>()};
+				}
+				v8::Local<v8::Value> columnOffset = Unmaybe(options->Get(context, v8_string("columnOffset")));
+				if (!columnOffset->IsUndefined()) {
+					if (!columnOffset->IsInt32()) {
+						throw js_type_error("`columnOffset` must be an integer");
+					}
+					this->columnOffset = columnOffset.As<v8::Int32>()->Value();
+				}
+				v8::Local<v8::Value> lineOffset = Unmaybe(options->Get(context, v8_string("lineOffset")));
+				if (!lineOffset->IsUndefined()) {
+					if (!lineOffset->IsInt32()) {
+						throw js_type_error("`lineOffset` must be an integer");
+					}
+					this->lineOffset = lineOffset.As<v8::Int32>()->Value();
+				}
+			}
+		}
+
+		v8::ScriptOrigin ToScriptOrigin() const {
+			v8::Isolate* isolate = v8::Isolate::GetCurrent();
+			v8::Local<v8::Integer> integer;
+			v8::Local<v8::Boolean> boolean;
+			v8::Local<v8::String> string;
+			return {
+				v8_string(filename.c_str()), // resource_name,
+				v8::Integer::New(isolate, columnOffset), // resource_line_offset
+				v8::Integer::New(isolate, lineOffset), // resource_column_offset
+				boolean, // resource_is_shared_cross_origin
+				integer, // script_id
+				string, // source_map_url
+				boolean, // resource_is_opaque
+				boolean, // is_wasm
+				v8::Boolean::New(isolate, this->isModule)
+			};
+		}
+};
+
+/**
+ * Run a function and annotate the exception with source / line number if it throws. Note that this
+ * only handles errors that live inside v8, not C++ errors
+ */
+template <typename T, typename F>
+T RunWithAnnotatedErrors(F&& fn) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::TryCatch try_catch(isolate);
+	try {
+		return fn();
+	} catch (const js_error_message& cc_error) {
+		throw std::logic_error("Invalid error thrown by RunWithAnnotatedErrors");
+	} catch (const js_runtime_error& cc_error) {
+		try {
+			assert(try_catch.HasCaught());
+			v8::Local<v8::Context> context = isolate->GetCurrentContext();
+			v8::Local<v8::Value> error = try_catch.Exception();
+			v8::Local<v8::Message> message = try_catch.Message();
+			assert(error->IsObject());
+			int linenum = Unmaybe(message->GetLineNumber(context));
+			int start_column = Unmaybe(message->GetStartColumn(context));
+			std::string decorator =
+				std::string{*v8::String::Utf8Value{isolate, message->GetScriptResourceName()}} +
+				":" + std::to_string(linenum) +
+				":" + std::to_string(start_column + 1);
+			std::string message_str = *v8::String::Utf8Value{isolate, Unmaybe(error.As<v8::Object>()->Get(context, v8_symbol("message")))};
+			Unmaybe(error.As<v8::Object>()->Set(context, v8_symbol("message"), v8_string((message_str + " [" + decorator + "]").c_str())));
+			isolate->ThrowException(error);
+			throw js_runtime_error();
+		} catch (const js_runtime_error& cc_error) {
+			try_catch.ReThrow();
+			throw js_runtime_error();
+		}
+	}
+}
+
+} // namespace ivm
@@ -0,0 +1,219 @@
+#include "script_template_handle.h"
+#include "external_copy.h"
+#include "isolate_handle.h"
+#include "script_handle.h"
+#include "script_origin.h"
+#include "isolate/remote_handle.h"
+#include "isolate/three_phase_task.h"
+#include "isolate/v8_version.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+
+using namespace v8;
+using std::shared_ptr;
+using std::unique_ptr;
+
+namespace ivm {
+
+/**
+ * Shared by every handle to a template, in any isolate
+ */
+class ScriptTemplateHandle::ScriptTemplate {
+	public:
+		const unique_ptr<ExternalCopyString> code_string;
+		const ScriptOriginHolder script_origin_holder;
+
+	private:
+		struct CodeCache {
+			shared_ptr<const ScriptCompiler::CachedData> cached_data;
+			// Set while the first isolate produces the code cache. Other isolates compile from scratch
+			// in the meantime instead of waiting, since they may be holding a pool thread.
+			bool producing = false;
+		};
+		// Isolates only accept a code cache made with the same v8 flags and snapshot, so there is one
+		// cache for each combination. Otherwise a fleet of mixed isolates would keep replacing it. The
+		// nodejs isolate has a snapshot of its own.
+		using code_cache_key_t = std::tuple<uint32_t, bool, const void*>;
+		static constexpr size_t kMinimumSweep = 64;
+
+		std::mutex mutex;
+		std::map<code_cache_key_t, CodeCache> code_caches;
+		// The `RemoteHandle` holds a reference to its `IsolateHolder` so these keys are never reused
+		std::unordered_map<IsolateHolder*, shared_ptr<RemoteHandle<UnboundScript>>> scripts;
+		// Scripts are swept for disposed isolates when there are this many of them
+		size_t sweep_at = kMinimumSweep;
+
+		static Local<UnboundScript> CompileUnbound(
+			Local<String> code, const ScriptOrigin& script_origin, const ScriptCompiler::CachedData* cached_data, bool& rejected
+		) {
+			ScriptCompiler::Source source(code, script_origin,
+				cached_data == nullptr ? nullptr : new ScriptCompiler::CachedData(cached_data->data, cached_data->length)
+			);
+			auto compile_options = cached_data == nullptr ? ScriptCompiler::kNoCompileOptions : ScriptCompiler::kConsumeCodeCache;
+			Local<UnboundScript> script = RunWithAnnotatedErrors<Local<UnboundScript>>(
+				[&source, compile_options]() { return Unmaybe(ScriptCompiler::CompileUnboundScript(Isolate::GetCurrent(), &source, compile_options)); }
+			);
+			rejected = cached_data != nullptr && source.GetCachedData()->rejected;
+			return script;
+		}
+
+		// Must be called with `mutex` held. Forgets scripts from isolates which have been disposed. The
+		// next sweep waits until there are twice as many scripts, so each compile pays a constant amount
+		// on average.
+		void Sweep() {
+			for (auto ii = scripts.begin(); ii != scripts.end(); ) {
+				if (ii->second->GetIsolateHolder()->GetIsolate()) {
+					++ii;
+				} else {
+					ii = scripts.erase(ii);
+				}
+			}
+			sweep_at = std::max(size_t{kMinimumSweep}, scripts.size() * 2);
+		}
+
+		static shared_ptr<const ScriptCompiler::CachedData> CreateCodeCache(Local<UnboundScript> script, Local<String> code) {
+			return shared_ptr<const ScriptCompiler::CachedData>{
+#if V8_AT_LEAST(6, 8, 11)
+				ScriptCompiler::CreateCodeCache(script)
+#else
+				ScriptCompiler::CreateCodeCache(script, code)
+#endif
+			};
+		}
+
+	public:
+		ScriptTemplate(Local<String> code_handle, MaybeLocal<Object> maybe_options) :
+			code_string(std::make_unique<ExternalCopyString>(code_handle)),
+			script_origin_holder(maybe_options) {}
+
+		/**
+		 * Returns this template's script for the current isolate, compiling it if needed
+		 */
+		shared_ptr<RemoteHandle<UnboundScript>> Get() {
+			IsolateHolder* holder = IsolateEnvironment::GetCurrentHolder().get();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto it = scripts.find(holder);
+				if (it != scripts.end()) {
+					return it->second;
+				}
+			}
+
+			Local<String> code = code_string->CopyIntoCheckHeap().As<String>();
+			ScriptOrigin script_origin = script_origin_holder.ToScriptOrigin();
+			Local<UnboundScript> script;
+			bool rejected = false;
+			bool produce = false;
+			shared_ptr<const ScriptCompiler::CachedData> cached;
+			IsolateEnvironment& env = *IsolateEnvironment::GetCurrent();
+			code_cache_key_t key{ScriptCompiler::CachedDataVersionTag(), env.IsDefault(), env.GetSnapshotBlob()};
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				CodeCache& code_cache = code_caches[key];
+				cached = code_cache.cached_data;
+				if (!cached && !code_cache.producing) {
+					code_cache.producing = produce = true;
+				}
+			}
+			if (!cached) {
+				try {
+					script = CompileUnbound(code, script_origin, nullptr, rejected);
+				} catch (...) {
+					if (produce) {
+						std::lock_guard<std::mutex> lock(mutex);
+						code_caches[key].producing = false;
+					}
+					throw;
+				}
+				if (produce) {
+					// First compile with these flags and snapshot
+					auto produced = CreateCodeCache(script, code);
+					std::lock_guard<std::mutex> lock(mutex);
+					CodeCache& code_cache = code_caches[key];
+					code_cache.cached_data = std::move(produced);
+					code_cache.producing = false;
+				}
+			} else {
+				script = CompileUnbound(code, script_origin, cached.get(), rejected);
+				if (rejected) {
+					// The snapshot this cache was made for is gone and another one took its address.
+					// Replace the cache with one that works here.
+					auto produced = CreateCodeCache(script, code);
+					std::lock_guard<std::mutex> lock(mutex);
+					CodeCache& code_cache = code_caches[key];
+					if (code_cache.cached_data == cached) {
+						code_cache.cached_data = std::move(produced);
+					}
+				}
+			}
+
+			auto remote = std::make_shared<RemoteHandle<UnboundScript>>(script);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (scripts.size() >= sweep_at) {
+				Sweep();
+			}
+			return scripts.emplace(holder, std::move(remote)).first->second;
+		}
+};
+
+/**
+ * ScriptTemplateHandle implementation
+ */
+ScriptTemplateHandle::ScriptTemplateTransferable::ScriptTemplateTransferable(
+	shared_ptr<ScriptTemplate> value
+) : value(std::move(value)) {}
+
+Local<Value> ScriptTemplateHandle::ScriptTemplateTransferable::TransferIn() {
+	return ClassHandle::NewInstance<ScriptTemplateHandle>(value);
+}
+
+ScriptTemplateHandle::ScriptTemplateHandle(shared_ptr<ScriptTemplate> value) : value(std::move(value)) {}
+
+Local<FunctionTemplate> ScriptTemplateHandle::Definition() {
+	return Inherit<TransferableHandle>(MakeClass(
+		"ScriptTemplate", ParameterizeCtor<decltype(&New), &New>(),
+		"compile", Parameterize<decltype(&ScriptTemplateHandle::Compile<1>), &ScriptTemplateHandle::Compile<1>>(),
+		"compileSync", Parameterize<decltype(&ScriptTemplateHandle::Compile<0>), &ScriptTemplateHandle::Compile<0>>()
+	));
+}
+
+unique_ptr<ScriptTemplateHandle> ScriptTemplateHandle::New(Local<String> code_handle, MaybeLocal<Object> maybe_options) {
+	return std::make_unique<ScriptTemplateHandle>(std::make_shared<ScriptTemplate>(code_handle, maybe_options));
+}
+
+unique_ptr<Transferable> ScriptTemplateHandle::TransferOut() {
+	return std::make_unique<ScriptTemplateTransferable>(value);
+}
+
+/**
+ * Compiles the template into an isolate and returns a ScriptHandle
+ */
+struct CompileTemplateRunner : public ThreePhaseTask {
+	shared_ptr<ScriptTemplateHandle::ScriptTemplate> value;
+	shared_ptr<RemoteHandle<UnboundScript>> script;
+
+	explicit CompileTemplateRunner(shared_ptr<ScriptTemplateHandle::ScriptTemplate> value) : value(std::move(value)) {}
+
+	void Phase2() final {
+		auto isolate = IsolateEnvironment::GetCurrent();
+		Context::Scope context_scope(isolate->DefaultContext());
+		IsolateEnvironment::HeapCheck heap_check{*isolate, true};
+		script = value->Get();
+		heap_check.Epilogue();
+	}
+
+	Local<Value> Phase3() final {
+		return ClassHandle::NewInstance<ScriptHandle>(std::move(script));
+	}
+};
+
+template <int async>
+Local<Value> ScriptTemplateHandle::Compile(IsolateHandle* isolate_handle) {
+	auto isolate = isolate_handle->GetIsolateHolder();
+	return ThreePhaseTask::Run<async, CompileTemplateRunner>(*isolate, value);
+}
+
+} // namespace ivm
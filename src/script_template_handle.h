@@ -0,0 +1,41 @@
+#pragma once
+#include <v8.h>
+#include "transferable_handle.h"
+#include <memory>
+
+namespace ivm {
+
+class IsolateHandle;
+
+/**
+ * Source code which can be compiled into any number of isolates. The first compile with each snapshot
+ * produces a code cache which the rest deserialize from, and each isolate's script is kept for later
+ * compiles.
+ */
+class ScriptTemplateHandle : public TransferableHandle {
+	public:
+		class ScriptTemplate;
+
+	private:
+		class ScriptTemplateTransferable : public Transferable {
+			private:
+				std::shared_ptr<ScriptTemplate> value;
+
+			public:
+				explicit ScriptTemplateTransferable(std::shared_ptr<ScriptTemplate> value);
+				v8::Local<v8::Value> TransferIn() final;
+		};
+
+		std::shared_ptr<ScriptTemplate> value;
+
+	public:
+		explicit ScriptTemplateHandle(std::shared_ptr<ScriptTemplate> value);
+		static v8::Local<v8::FunctionTemplate> Definition();
+		static std::unique_ptr<ScriptTemplateHandle> New(v8::Local<v8::String> code_handle, v8::MaybeLocal<v8::Object> maybe_options);
+		std::unique_ptr<Transferable> TransferOut() final;
+
+		template <int async>
+		v8::Local<v8::Value> Compile(IsolateHandle* isolate_handle);
+};
+
+} // namespace ivm
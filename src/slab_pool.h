@@ -0,0 +1,90 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+// This file contains no v8 code and is therefore free from v8's naming conventions
+
+/**
+ * Size-class pool for small allocations. Each class carves blocks out of 64kb chunks, and freed
+ * blocks go on a per-class free list for reuse. Chunks are only given back to the system when the
+ * pool is destroyed, so a pool should be owned by whatever is responsible for all of its blocks.
+ */
+class slab_pool_t {
+	public:
+		static constexpr size_t kMaxSize = 4096;
+
+	private:
+		static constexpr size_t kMinShift = 4;
+		static constexpr size_t kClasses = 9;
+		static constexpr size_t kChunkSize = 64 * 1024;
+
+		struct free_block_t {
+			free_block_t* next;
+		};
+
+		struct size_class_t {
+			free_block_t* free_list = nullptr;
+			char* next = nullptr;
+			char* end = nullptr;
+		};
+
+		std::mutex mutex;
+		std::array<size_class_t, kClasses> classes;
+		std::vector<void*> chunks;
+
+		static size_t class_index(size_t length) {
+			size_t index = 0;
+			while ((size_t{1} << (index + kMinShift)) < length) {
+				++index;
+			}
+			return index;
+		}
+
+	public:
+		slab_pool_t() = default;
+		slab_pool_t(const slab_pool_t&) = delete;
+		slab_pool_t& operator= (const slab_pool_t&) = delete;
+
+		~slab_pool_t() {
+			for (void* chunk : chunks) {
+				std::free(chunk);
+			}
+		}
+
+		// Returns uninitialized memory for `length <= kMaxSize` bytes, or nullptr on failure
+		void* allocate(size_t length) {
+			size_t index = class_index(length);
+			size_t block_size = size_t{1} << (index + kMinShift);
+			std::lock_guard<std::mutex> lock(mutex);
+			size_class_t& size_class = classes[index];
+			if (size_class.free_list != nullptr) {
+				free_block_t* block = size_class.free_list;
+				size_class.free_list = block->next;
+				return block;
+			}
+			if (size_class.next == size_class.end) {
+				void* chunk = std::malloc(kChunkSize);
+				if (chunk == nullptr) {
+					return nullptr;
+				}
+				chunks.push_back(chunk);
+				size_class.next = static_cast<char*>(chunk);
+				size_class.end = size_class.next + kChunkSize;
+			}
+			void* block = size_class.next;
+			size_class.next += block_size;
+			return block;
+		}
+
+		// `length` must be the same as was passed to `allocate`
+		void free(void* ptr, size_t length) {
+			size_class_t& size_class = classes[class_index(length)];
+			auto block = static_cast<free_block_t*>(ptr);
+			std::lock_guard<std::mutex> lock(mutex);
+			block->next = size_class.free_list;
+			size_class.free_list = block;
+		}
+};
@@ -1,136 +1,406 @@
 #pragma once
-#include <thread>
-#include <mutex>
+#include <atomic>
 #include <condition_variable>
-#include <functional>
-#include <list>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 // This file contains no v8 code and is therefore free from v8's naming conventions
 
+/**
+ * Work-stealing thread pool. Each worker owns a deque of tasks guarded by its own mutex, so posting a
+ * task only contends with the worker it lands on. Idle workers steal from busy ones. The pool never
+ * runs more than `desired_size` tasks at once-- when every worker is busy the task waits in a deque
+ * instead of getting a thread of its own. Workers which are blocked waiting on another thread (see
+ * `blocking_t`) don't count towards that limit. Low priority tasks wait in a second deque and only
+ * run when no normal task is waiting anywhere in the pool.
+ */
 class thread_pool_t {
+	private:
+		struct worker_t;
+
 	public:
 		using entry_t = void(bool, void*);
 		class affinity_t {
 			friend class thread_pool_t;
-			std::list<size_t> ids;
+			// Worker which most recently ran a task for this affinity. This is just a hint so relaxed
+			// ordering is fine.
+			std::atomic<worker_t*> worker{nullptr};
 		};
 
 	private:
-		size_t desired_size;
-		std::mutex mutex;
-		size_t rr;
-
-		struct thread_data_t {
-			std::unique_ptr<std::condition_variable> cv;
-			bool should_exit = false;
+		struct task_t {
 			entry_t* entry = nullptr;
 			void* param = nullptr;
-			thread_data_t() : cv(std::make_unique<std::condition_variable>()) {}
+			affinity_t* affinity = nullptr;
+			bool low_priority = false;
 		};
 
-		std::vector<thread_data_t> thread_data;
-		std::vector<std::thread> threads;
-
-		size_t new_thread() {
-			// no lock needed here since this is only called from `exec` which will have a lock
-			thread_data.emplace_back();
-			size_t ii = thread_data.size() - 1;
-			threads.emplace_back(std::thread([ this, ii ]() {
-				std::unique_lock<std::mutex> lock(mutex);
-				while (!thread_data[ii].should_exit) {
-					if (thread_data[ii].entry == nullptr) {
-						thread_data[ii].cv->wait(lock);
-					} else {
-						entry_t* entry = thread_data[ii].entry;
-						void* param = thread_data[ii].param;
-						lock.unlock();
-						entry(true, param);
-						lock.lock();
-						thread_data[ii].entry = nullptr;
-						thread_data[ii].param = nullptr;
-					}
-				}
-			}));
-			return ii;
+		struct worker_t {
+			std::mutex mutex;
+			std::condition_variable cv;
+			std::deque<task_t> tasks;
+			std::deque<task_t> low_priority_tasks;
+			std::thread thread;
+			std::atomic<bool> idle{false};
+			// Set by a retired worker's thread just before it returns, after which the worker may be reused
+			std::atomic<bool> exited{false};
+			bool should_exit = false;
+		};
+
+		// Immutable snapshot of the active workers. Snapshots are reference counted so an old one is
+		// freed as soon as the last thread looking at it lets go. Workers themselves are never freed
+		// until the pool is destroyed since affinity hints may still point to them, but retired workers
+		// are reused when the pool grows again so there are never more than the peak number of threads.
+		using worker_list_t = std::vector<worker_t*>;
+		using worker_list_ptr = std::shared_ptr<const worker_list_t>;
+
+		std::atomic<size_t> desired_size;
+		// Number of workers inside a `blocking_t`
+		std::atomic<size_t> blocked{0};
+		std::atomic<size_t> rr{0};
+		worker_list_ptr active;
+		std::mutex resize_mutex;
+		std::vector<std::unique_ptr<worker_t>> workers;
+
+		worker_list_ptr snapshot() const {
+			return std::atomic_load(&active);
 		}
 
-	public:
-		explicit thread_pool_t(size_t desired_size) noexcept : desired_size(desired_size), rr(0) {}
-		thread_pool_t(const thread_pool_t&) = delete;
-		thread_pool_t& operator= (const thread_pool_t&) = delete;
+		// Pool and worker which own the current thread, if any
+		struct current_t {
+			thread_pool_t* pool = nullptr;
+			worker_t* worker = nullptr;
+		};
+		static current_t& this_thread() {
+			static thread_local current_t current;
+			return current;
+		}
 
-		~thread_pool_t() {
-			resize(0);
+		// Blocked workers are replaced, so this is how many workers may exist right now
+		size_t max_size() const {
+			return desired_size + blocked;
+		}
+
+		// Atomically take an idle worker for ourselves
+		static bool claim(worker_t& worker) {
+			bool expected = true;
+			return worker.idle.compare_exchange_strong(expected, false);
+		}
+
+		// Returns false if the worker is on its way out, in which case the caller should try again
+		static bool push(worker_t& worker, const task_t& task, bool notify) {
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			if (worker.should_exit) {
+				return false;
+			}
+			enqueue(worker, task);
+			if (notify) {
+				worker.cv.notify_one();
+			}
+			return true;
 		}
 
-		void exec(affinity_t& affinity, entry_t* entry, void* param) {
-			std::lock_guard<std::mutex> lock(this->mutex);
+		// Worker's mutex must be held
+		static void enqueue(worker_t& worker, const task_t& task) {
+			(task.low_priority ? worker.low_priority_tasks : worker.tasks).push_back(task);
+		}
 
-			// First try to use an old thread
-			int thread = -1;
-			for (auto ii = affinity.ids.begin(); ii != affinity.ids.end(); ) {
-				if (*ii >= thread_data.size()) {
-					ii = affinity.ids.erase(ii);
+		// Worker's mutex must be held
+		static bool has_tasks(const worker_t& worker) {
+			return !worker.tasks.empty() || !worker.low_priority_tasks.empty();
+		}
+
+		// Called after a task was pushed to a busy worker. If a worker went idle in the meantime it
+		// will be woken up and steal the task.
+		static bool wake_idle(const worker_list_t& list) {
+			for (worker_t* worker : list) {
+				if (claim(*worker)) {
+					// Lock is needed so the notification isn't lost between the worker checking its predicate
+					// and going to sleep.
+					std::lock_guard<std::mutex> lock(worker->mutex);
+					worker->cv.notify_one();
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Grab a task from this worker's own deque or steal one from a sibling. Normal tasks from anywhere
+		// are preferred over low priority ones.
+		bool take(worker_t& self, task_t& task) {
+			return take(self, task, &worker_t::tasks) || take(self, task, &worker_t::low_priority_tasks);
+		}
+
+		bool take(worker_t& self, task_t& task, std::deque<task_t> worker_t::*queue) {
+			{
+				std::lock_guard<std::mutex> lock(self.mutex);
+				if (self.should_exit) {
+					return false;
+				}
+				if (!(self.*queue).empty()) {
+					task = (self.*queue).front();
+					(self.*queue).pop_front();
+					return true;
+				}
+			}
+			// Tasks are isolate wake-ups which may run for a long time, so thieves take from the front
+			// as well to keep things roughly FIFO.
+			worker_list_ptr current = snapshot();
+			const worker_list_t& list = *current;
+			size_t size = list.size();
+			size_t offset = rr++;
+			for (size_t ii = 0; ii < size; ++ii) {
+				worker_t& victim = *list[(ii + offset) % size];
+				if (&victim == &self) {
+					continue;
+				}
+				std::lock_guard<std::mutex> lock(victim.mutex);
+				if (!(victim.*queue).empty()) {
+					task = (victim.*queue).front();
+					(victim.*queue).pop_front();
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void entry(worker_t& self) {
+			this_thread() = { this, &self };
+			std::unique_lock<std::mutex> lock(self.mutex, std::defer_lock);
+			task_t task;
+			while (true) {
+				if (take(self, task)) {
+					task.affinity->worker.store(&self, std::memory_order_relaxed);
+					task.entry(true, task.param);
+					continue;
+				}
+				// Advertise as idle and then look once more. `exec` checks for idle workers after it
+				// pushes a task so one of the two will notice.
+				self.idle = true;
+				if (take(self, task)) {
+					self.idle = false;
+					task.affinity->worker.store(&self, std::memory_order_relaxed);
+					task.entry(true, task.param);
 					continue;
 				}
-				if (thread_data[*ii].entry == nullptr) {
-					thread = *ii;
-					if (ii != affinity.ids.begin()) {
-						// Move last used thread to front
-						affinity.ids.erase(ii);
-						affinity.ids.push_front(thread);
+				lock.lock();
+				self.cv.wait(lock, [&]() { return self.should_exit || has_tasks(self) || !self.idle; });
+				self.idle = false;
+				if (self.should_exit) {
+					// Hand leftover tasks back to the pool
+					std::deque<task_t> orphans;
+					std::swap(orphans, self.tasks);
+					orphans.insert(orphans.end(), self.low_priority_tasks.begin(), self.low_priority_tasks.end());
+					self.low_priority_tasks.clear();
+					lock.unlock();
+					for (auto& orphan : orphans) {
+						post(orphan);
 					}
+					self.exited = true;
+					return;
+				}
+				lock.unlock();
+			}
+		}
+
+		// Must be called with `resize_mutex` held
+		void publish(std::unique_ptr<worker_list_t> list) {
+			std::atomic_store(&active, worker_list_ptr{std::move(list)});
+		}
+
+		// Must be called with `resize_mutex` held. Returns a retired worker whose thread has finished, or
+		// a brand new one.
+		worker_t* new_worker(worker_list_t& list) {
+			worker_t* worker = nullptr;
+			for (auto& retired : workers) {
+				if (retired->exited) {
+					retired->thread.join();
+					retired->exited = false;
+					worker = retired.get();
 					break;
 				}
-				++ii;
 			}
+			if (worker == nullptr) {
+				workers.emplace_back(std::make_unique<worker_t>());
+				worker = workers.back().get();
+			}
+			list.push_back(worker);
+			return worker;
+		}
+
+		// Adds a single worker, with the task already queued if there is one. Returns false if another
+		// thread filled the pool up first.
+		bool spawn(const task_t* task) {
+			std::lock_guard<std::mutex> lock(resize_mutex);
+			auto list = std::make_unique<worker_list_t>(*snapshot());
+			if (list->size() >= max_size()) {
+				return false;
+			}
+			worker_t* worker = new_worker(*list);
+			{
+				// A reused worker may still be the target of a stale affinity hint
+				std::lock_guard<std::mutex> lock(worker->mutex);
+				worker->should_exit = false;
+				if (task != nullptr) {
+					enqueue(*worker, *task);
+				}
+			}
+			worker->thread = std::thread([ this, worker ]() { entry(*worker); });
+			publish(std::move(list));
+			return true;
+		}
+
+		void post(const task_t& task) {
+			worker_t* preferred = task.affinity->worker.load(std::memory_order_relaxed);
+			while (true) {
+				worker_list_ptr current = snapshot();
+				const worker_list_t& list = *current;
+				size_t size = list.size();
 
-			if (thread == -1) {
-				if (desired_size > threads.size()) {
-					// Thread pool hasn't yet reached `desired_size`, so we can make a new thread
-					thread = new_thread();
-					affinity.ids.push_front(thread);
+				// Prefer whichever worker ran this last, then any idle worker
+				worker_t* target = nullptr;
+				if (preferred != nullptr && claim(*preferred)) {
+					target = preferred;
 				} else {
-					// Now try to re-use a non-busy thread
 					size_t offset = rr++;
-					for (size_t ii = 0; ii < thread_data.size(); ++ii) {
-						size_t jj = (rr + ii + offset) % thread_data.size();
-						if (thread_data[jj].entry == nullptr) {
-							thread = jj;
-							affinity.ids.push_front(thread);
+					for (size_t ii = 0; ii < size; ++ii) {
+						worker_t* worker = list[(ii + offset) % size];
+						if (claim(*worker)) {
+							target = worker;
 							break;
 						}
 					}
+				}
+
+				if (target != nullptr) {
+					if (push(*target, task, true)) {
+						return;
+					} else if (target == preferred) {
+						preferred = nullptr;
+					}
+					continue;
+				}
 
-					if (thread == -1) {
-						// All threads are busy and pool is full, just run this in a new thread
-						std::thread tmp_thread(std::bind(entry, false, param));
-						tmp_thread.detach();
+				// Everyone is busy
+				if (size < max_size()) {
+					if (spawn(&task)) {
 						return;
 					}
+					continue;
+				} else if (size == 0) {
+					// Only possible while the pool is being destroyed
+					return;
+				}
+				target = preferred == nullptr ? list[rr++ % size] : preferred;
+				if (push(*target, task, false)) {
+					wake_idle(list);
+					return;
+				} else if (target == preferred) {
+					preferred = nullptr;
+				}
+			}
+		}
+
+	public:
+		explicit thread_pool_t(size_t desired_size) noexcept :
+			desired_size(desired_size), active(std::make_shared<const worker_list_t>()) {}
+		thread_pool_t(const thread_pool_t&) = delete;
+		thread_pool_t& operator= (const thread_pool_t&) = delete;
+
+		~thread_pool_t() {
+			resize(0);
+			for (auto& worker : workers) {
+				if (worker->thread.joinable()) {
+					worker->thread.join();
 				}
 			}
+		}
 
-			thread_data[thread].entry = entry;
-			thread_data[thread].param = param;
-			thread_data[thread].cv->notify_one();
+		void exec(affinity_t& affinity, entry_t* entry, void* param, bool low_priority = false) {
+			task_t task;
+			task.entry = entry;
+			task.param = param;
+			task.affinity = &affinity;
+			task.low_priority = low_priority;
+			post(task);
 		}
 
+		// Changes the maximum number of concurrent tasks. Threads are started on demand, and surplus
+		// threads exit after they finish what they are currently running. This never blocks on running
+		// tasks.
 		void resize(size_t size) {
-			std::unique_lock<std::mutex> lock(this->mutex);
+			std::lock_guard<std::mutex> lock(resize_mutex);
 			desired_size = size;
-			if (thread_data.size() > desired_size) {
-				for (size_t ii = desired_size; ii < thread_data.size(); ++ii) {
-					thread_data[ii].should_exit = true;
-					thread_data[ii].cv->notify_one();
+			retire(max_size());
+		}
+
+		size_t size() const {
+			return desired_size;
+		}
+
+		/**
+		 * Marks the current pool thread as blocked for the lifetime of this object, for example while
+		 * it waits on another thread which may in turn need the pool. The blocked worker doesn't count
+		 * towards the pool size, so a replacement takes over anything queued on it, and new tasks can
+		 * still start. The surplus worker is retired once the block ends. This does nothing on threads
+		 * which don't belong to a pool.
+		 */
+		class blocking_t {
+			private:
+				thread_pool_t* pool;
+			public:
+				blocking_t() : pool(this_thread().pool) {
+					if (pool != nullptr) {
+						pool->begin_blocking(*this_thread().worker);
+					}
 				}
-				lock.unlock();
-				for (size_t ii = desired_size; ii < thread_data.size(); ++ii) {
-					threads[ii].join();
+				blocking_t(const blocking_t&) = delete;
+				blocking_t& operator= (const blocking_t&) = delete;
+				~blocking_t() {
+					if (pool != nullptr) {
+						pool->end_blocking();
+					}
+				}
+		};
+
+	private:
+		void begin_blocking(worker_t& self) {
+			++blocked;
+			bool waiting;
+			{
+				std::lock_guard<std::mutex> lock(self.mutex);
+				waiting = has_tasks(self);
+			}
+			// Tasks queued here would otherwise wait out the block. An idle sibling can steal them,
+			// failing that a replacement worker is started.
+			if (waiting && !wake_idle(*snapshot())) {
+				spawn(nullptr);
+			}
+		}
+
+		void end_blocking() {
+			--blocked;
+			if (snapshot()->size() > max_size()) {
+				std::lock_guard<std::mutex> lock(resize_mutex);
+				retire(max_size());
+			}
+		}
+
+		// Must be called with `resize_mutex` held. Retires workers past `size`, which exit after they
+		// finish what they are currently running.
+		void retire(size_t size) {
+			worker_list_ptr list = snapshot();
+			const worker_list_t& current = *list;
+			if (current.size() > size) {
+				publish(std::make_unique<worker_list_t>(current.begin(), current.begin() + size));
+				for (size_t ii = size; ii < current.size(); ++ii) {
+					std::lock_guard<std::mutex> lock(current[ii]->mutex);
+					current[ii]->should_exit = true;
+					current[ii]->cv.notify_one();
 				}
-				thread_data.resize(desired_size);
-				threads.resize(desired_size);
 			}
 		}
 };
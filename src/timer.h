@@ -1,242 +1,406 @@
 #pragma once
 #include <uv.h>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
-#include <queue>
-#include <stdexcept>
 #include <thread>
-#include <unordered_set>
+#include <utility>
 
 namespace ivm {
 
 /**
  * isolated-vm could start timers from different threads which libuv isn't really cut out for, so
- * I'm rolling my own here. The goal of the library is to have atomic timers without spawning a new
- * thread for each timer.
+ * I'm rolling my own here. Every timer lives in a single hierarchical timing wheel with 1ms ticks,
+ * so starting and cancelling a timer are both constant time and a cancelled timer is gone right
+ * away instead of lingering until it would have fired.
+ *
+ * Callbacks run on whichever thread is currently driving the wheel. A callback which is going to
+ * block calls `chain()` first, which hands the wheel off to another thread. Threads are only added
+ * when all of them are stuck in callbacks, so in practice there are just one or two.
  */
 class timer_t {
 	private:
 		using callback_t = std::function<void(void*)>;
+		using clock = std::chrono::steady_clock;
+		struct timer_list_t;
+		struct timer_data_t;
 
 		/**
-		 * Contains data on a timer. This is shared between the timer handle and the thread responsible
-		 * for the timer.
+		 * Passed to callbacks as the opaque `next` pointer
+		 */
+		struct run_state_t {
+			timer_data_t* data = nullptr;
+			bool leading = false;
+		};
+
+		/**
+		 * Contains data on a timer. This is shared between the timer handle and the wheel.
 		 */
 		struct timer_data_t {
 			callback_t callback;
 			void** holder = nullptr;
-			void* last_holder_value;
-			std::chrono::steady_clock::time_point timeout;
-			std::chrono::steady_clock::time_point paused_at{};
-			std::chrono::steady_clock::duration paused_duration{};
-			std::shared_ptr<timer_data_t> threadless_self;
-			bool is_alive = true;
+			void* last_holder_value = nullptr;
+			clock::time_point timeout;
+			clock::time_point paused_at{};
+			clock::duration paused_duration{};
+			uint64_t expires = 0;
+			// Intrusive links into a wheel slot or the run queue
+			timer_data_t* prev = nullptr;
+			timer_data_t* next = nullptr;
+			timer_list_t* list = nullptr;
+			bool is_detached = false;
+			bool is_parked = false;
 			bool is_running = false;
 			bool is_dtor_waiting = false;
 
-			timer_data_t(std::chrono::steady_clock::time_point timeout, void** holder, callback_t callback) :
-				callback(std::move(callback)), holder(holder), timeout(timeout) {
-				if (holder != nullptr) {
-					last_holder_value = std::exchange(*holder, static_cast<void*>(this));
-				}
-			}
-
-			bool adjust() {
-				if (paused_duration == std::chrono::steady_clock::duration{}) {
-					return false;
-				} else {
-					timeout += paused_duration;
-					paused_duration = {};
-					return true;
-				}
-			}
+			timer_data_t(clock::time_point timeout, void** holder, callback_t callback) :
+				callback(std::move(callback)), holder(holder), timeout(timeout) {}
+			timer_data_t(const timer_data_t&) = delete;
+			timer_data_t& operator= (const timer_data_t&) = delete;
 
-			bool is_paused() {
-				return paused_at != std::chrono::steady_clock::time_point{};
+			bool is_paused() const {
+				return paused_at != clock::time_point{};
 			}
 
 			void pause() {
-				paused_at = std::chrono::steady_clock::now();
+				paused_at = clock::now();
 			}
 
 			void resume() {
-				paused_duration += std::chrono::steady_clock::now() - paused_at;
+				paused_duration += clock::now() - paused_at;
 				paused_at = {};
 			}
+		};
+
+		/**
+		 * Doubly linked list of timers, so any timer can be unlinked in constant time.
+		 */
+		struct timer_list_t {
+			timer_data_t* head = nullptr;
+			timer_data_t* tail = nullptr;
+
+			bool empty() const {
+				return head == nullptr;
+			}
+
+			void push(timer_data_t* data) {
+				data->list = this;
+				data->prev = tail;
+				data->next = nullptr;
+				if (tail == nullptr) {
+					head = data;
+				} else {
+					tail->next = data;
+				}
+				tail = data;
+			}
 
-			struct cmp {
-				bool operator()(const std::shared_ptr<timer_data_t>& left, const std::shared_ptr<timer_data_t>& right) const {
-					return left->timeout > right->timeout;
+			void remove(timer_data_t* data) {
+				if (data->prev == nullptr) {
+					head = data->next;
+				} else {
+					data->prev->next = data->next;
 				}
-			};
+				if (data->next == nullptr) {
+					tail = data->prev;
+				} else {
+					data->next->prev = data->prev;
+				}
+				data->prev = data->next = nullptr;
+				data->list = nullptr;
+			}
+
+			timer_data_t* shift() {
+				timer_data_t* data = head;
+				remove(data);
+				return data;
+			}
 		};
-		static void run(std::shared_ptr<timer_data_t> data, std::unique_lock<std::mutex>& lock, class timer_thread_t& thread);
 
 		/**
-		 * Manager for a thread which handles 1 or many timers.
+		 * The wheel has `kLevels` levels of `kSlots` slots. Level 0 holds timers due in the next 64ms,
+		 * level 1 the next ~4s, level 2 the next ~4m, and level 3 the next ~4.5h. When the clock
+		 * crosses a slot boundary in a higher level that slot is cascaded down into the lower levels.
+		 * Anything further out than that waits in the last slot of the top level and is re-inserted
+		 * when it comes up.
 		 */
-		class timer_thread_t {
-			public:
-				std::chrono::steady_clock::time_point next_timeout;
-				std::priority_queue<
-					std::shared_ptr<timer_data_t>,
-					std::deque<std::shared_ptr<timer_data_t>>,
-					timer_data_t::cmp
-				> queue;
-				// Keep copies to these references because in some cases the library will unload while
-				// threads are still active causing an ungraceful exit
-				std::mutex& global_mutex;
-				std::unordered_set<timer_thread_t*>& thread_list;
-
-				explicit timer_thread_t(std::shared_ptr<timer_data_t> first_timer) :
-						next_timeout{first_timer->timeout}, queue{&first_timer, &first_timer + 1},
-						global_mutex{timer_t::global_mutex()}, thread_list{timer_t::thread_list()} {
-					std::thread thread{std::bind(&timer_thread_t::entry, this)};
-					thread.detach();
+		class wheel_t {
+			private:
+				static constexpr int kLevelBits = 6;
+				static constexpr int kLevels = 4;
+				static constexpr uint64_t kSlots = 1 << kLevelBits;
+				static constexpr uint64_t kNever = std::numeric_limits<uint64_t>::max();
+
+				const clock::time_point epoch = clock::now();
+				uint64_t current_tick = 0;
+				// Tick the leader is sleeping until. 0 while it's awake.
+				uint64_t wake_tick = 0;
+				size_t count = 0;
+				size_t threads = 0;
+				size_t followers = 0;
+				bool has_leader = false;
+				std::array<std::array<timer_list_t, kSlots>, kLevels> slots;
+				// Timers which are due and waiting for the leader to run them
+				timer_list_t due;
+				std::condition_variable leader_cv;
+				std::condition_variable follower_cv;
+
+				uint64_t now_tick() const {
+					return std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - epoch).count();
 				}
 
-				void entry() {
-					std::unique_lock<std::mutex> lock{global_mutex, std::defer_lock};
-					while (true) {
-						std::this_thread::sleep_until(next_timeout);
-						lock.lock();
-						next_timeout = std::chrono::steady_clock::now();
-						run_next(lock);
-						if (queue.empty()) {
-							auto ii = thread_list.find(this);
-							if (ii == thread_list.end()) {
-								throw std::logic_error("Didn't find thread in thread list");
-							}
-							thread_list.erase(ii);
-							delete this;
-							return;
-						}
-						next_timeout = queue.top()->timeout;
-						lock.unlock();
+				uint64_t ceil_tick(clock::time_point time) const {
+					if (time <= epoch) {
+						return 0;
 					}
+					auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(time - epoch);
+					return ms.count() + (epoch + ms < time ? 1 : 0);
 				}
 
-				void run_next(std::unique_lock<std::mutex>& lock) {
-					auto data = std::move(queue.top());
-					queue.pop();
-					run(std::move(data), lock, *this);
+				void insert(timer_data_t* data) {
+					uint64_t tick = std::max(data->expires, current_tick);
+					uint64_t delta = tick - current_tick;
+					int level = 0;
+					while (level < kLevels - 1 && delta >= uint64_t{1} << (kLevelBits * (level + 1))) {
+						++level;
+					}
+					if (delta >= uint64_t{1} << (kLevelBits * kLevels)) {
+						tick = current_tick + (uint64_t{1} << (kLevelBits * kLevels)) - 1;
+					}
+					slots[level][(tick >> (kLevelBits * level)) & (kSlots - 1)].push(data);
+					++count;
 				}
 
-				void maybe_run_next(std::unique_lock<std::mutex>& lock) {
-					if (!queue.empty() && queue.top()->timeout <= next_timeout) {
-						run_next(lock);
+				// Returns the next tick at which a slot needs attention, either because timers expire or
+				// because a higher level needs to be cascaded.
+				uint64_t next_event() const {
+					uint64_t next = kNever;
+					for (int level = 0; level < kLevels; ++level) {
+						int shift = kLevelBits * level;
+						uint64_t base = current_tick >> shift;
+						for (uint64_t ii = 1; ii <= kSlots; ++ii) {
+							if (!slots[level][(base + ii) & (kSlots - 1)].empty()) {
+								next = std::min(next, (base + ii) << shift);
+								break;
+							}
+						}
 					}
+					return next;
 				}
-		};
-
-		/**
-		 * Global mutex and list of active threads
-		 */
-		static std::mutex& global_mutex() {
-			static auto global_mutex = new std::mutex;
-			return *global_mutex;
-		}
 
-		static std::condition_variable& global_cv() {
-			static std::condition_variable cv;
-			return cv;
-		}
+				// Moves expired timers to the run queue
+				void advance(uint64_t tick) {
+					while (current_tick < tick) {
+						uint64_t next = count == 0 ? kNever : next_event();
+						if (next > tick) {
+							current_tick = tick;
+							return;
+						}
+						current_tick = next;
+						for (int level = 1; level < kLevels; ++level) {
+							if ((current_tick & ((uint64_t{1} << (kLevelBits * level)) - 1)) != 0) {
+								break;
+							}
+							auto& list = slots[level][(current_tick >> (kLevelBits * level)) & (kSlots - 1)];
+							while (!list.empty()) {
+								timer_data_t* data = list.shift();
+								--count;
+								insert(data);
+							}
+						}
+						auto& list = slots[0][current_tick & (kSlots - 1)];
+						while (!list.empty()) {
+							timer_data_t* data = list.shift();
+							--count;
+							due.push(data);
+						}
+					}
+				}
 
-		static std::unordered_set<timer_thread_t*>& thread_list() {
-			static auto thread_list = new std::unordered_set<timer_thread_t*>;
-			return *thread_list;
-		}
+				void spawn() {
+					++threads;
+					std::thread thread{[this]() { entry(); }};
+					thread.detach();
+				}
 
-		// Lock must be locked!
-		static void start_or_join_timer(std::shared_ptr<timer_data_t> data) {
-			// Try to find a thread to put this timer into
-			for (auto& thread : thread_list()) {
-				if (thread->next_timeout < data->timeout) {
-					thread->queue.push(std::move(data));
-					return;
+				void entry() {
+					std::unique_lock<std::mutex> lock{mutex};
+					run_state_t state;
+					while (true) {
+						if (has_leader) {
+							if (followers != 0) {
+								// Someone else is already waiting in reserve
+								--threads;
+								return;
+							}
+							++followers;
+							follower_cv.wait(lock, [&]() { return !has_leader; });
+							--followers;
+							continue;
+						}
+						has_leader = true;
+						state.leading = true;
+						lead(lock, state);
+					}
 				}
-			}
 
-			// Time to spawn a new thread
-			thread_list().insert(new timer_thread_t(std::move(data)));
-		}
+				// Drives the wheel until a callback calls `chain()`
+				void lead(std::unique_lock<std::mutex>& lock, run_state_t& state) {
+					while (true) {
+						wake_tick = 0;
+						advance(now_tick());
+						if (!due.empty()) {
+							run(due.shift(), lock, state);
+							if (!state.leading) {
+								return;
+							}
+							continue;
+						}
+						wake_tick = count == 0 ? kNever : next_event();
+						if (wake_tick == kNever) {
+							leader_cv.wait(lock);
+						} else {
+							leader_cv.wait_until(lock, epoch + std::chrono::milliseconds(wake_tick));
+						}
+					}
+				}
 
-		// Lock must be locked! It will be returned locked as well.
-		static void run(std::shared_ptr<timer_data_t> data, std::unique_lock<std::mutex>& lock, timer_thread_t& thread) {
-			if (data->is_alive) {
-				if (data->is_paused()) {
-					data->threadless_self = std::move(data);
-				} else if (data->adjust()) {
-					start_or_join_timer(std::move(data));
-				} else {
+				void run(timer_data_t* data, std::unique_lock<std::mutex>& lock, run_state_t& state) {
+					if (data->is_paused()) {
+						// `resume()` will put this back in the wheel
+						data->is_parked = true;
+						return;
+					} else if (data->paused_duration != clock::duration{}) {
+						data->timeout += data->paused_duration;
+						data->paused_duration = {};
+						schedule(data);
+						return;
+					}
 					data->is_running = true;
+					state.data = data;
 					lock.unlock();
-					data->callback(reinterpret_cast<void*>(&thread));
+					data->callback(static_cast<void*>(&state));
 					lock.lock();
+					state.data = nullptr;
 					data->is_running = false;
-					if (data->is_dtor_waiting) {
-						global_cv().notify_all();
+					if (data->is_detached) {
+						if (data->list == nullptr) {
+							lock.unlock();
+							delete data;
+							lock.lock();
+						}
+					} else if (data->is_dtor_waiting) {
+						dtor_cv.notify_all();
 					}
-					return;
 				}
-			} else {
-				data.reset();
-			}
-			thread.maybe_run_next(lock);
+
+			public:
+				std::mutex mutex;
+				std::condition_variable dtor_cv;
+
+				// Lock must be locked!
+				void schedule(timer_data_t* data) {
+					data->expires = std::max(ceil_tick(data->timeout), current_tick + 1);
+					insert(data);
+					if (threads == 0) {
+						spawn();
+					} else if (data->expires < wake_tick) {
+						leader_cv.notify_one();
+					}
+				}
+
+				// Lock must be locked!
+				void cancel(timer_data_t* data) {
+					if (data->list != nullptr) {
+						if (data->list != &due) {
+							--count;
+						}
+						data->list->remove(data);
+					}
+				}
+
+				// Lock must be locked! Called from a callback which is about to block.
+				void hand_off(run_state_t& state) {
+					if (state.leading) {
+						state.leading = false;
+						has_leader = false;
+						if (followers == 0) {
+							spawn();
+						} else {
+							follower_cv.notify_one();
+						}
+					}
+				}
+		};
+
+		/**
+		 * The wheel and its threads are never destroyed, because in some cases the library will unload
+		 * while threads are still active causing an ungraceful exit
+		 */
+		static wheel_t& wheel() {
+			static auto wheel = new wheel_t;
+			return *wheel;
 		}
 
-	public:
-		std::shared_ptr<timer_data_t> data;
+		timer_data_t data;
 
+	public:
 		// Runs a callback unless the `timer_t` destructor is called.
-		timer_t(uint32_t ms, void** holder, callback_t callback) {
-			std::lock_guard<std::mutex> lock(global_mutex());
-			data = std::make_shared<timer_data_t>(
-				std::chrono::steady_clock::now() + std::chrono::milliseconds(ms),
-				holder, std::move(callback)
-			);
-			start_or_join_timer(data);
+		timer_t(uint32_t ms, void** holder, callback_t callback) :
+				data{clock::now() + std::chrono::milliseconds(ms), holder, std::move(callback)} {
+			std::lock_guard<std::mutex> lock(wheel().mutex);
+			if (holder != nullptr) {
+				data.last_holder_value = std::exchange(*holder, static_cast<void*>(&data));
+			}
+			wheel().schedule(&data);
 		}
 		timer_t(uint32_t ms, callback_t callback) : timer_t(ms, nullptr, std::move(callback)) {}
 		timer_t(const timer_t&) = delete;
 		timer_t& operator= (const timer_t&) = delete;
 
 		~timer_t() {
-			std::unique_lock<std::mutex> lock(global_mutex());
-			if (data->is_running) {
-				data->is_dtor_waiting = true;
-				auto& cv = global_cv();
-				do {
-					cv.wait(lock);
-				} while (data->is_running);
+			std::unique_lock<std::mutex> lock(wheel().mutex);
+			if (data.is_running) {
+				data.is_dtor_waiting = true;
+				wheel().dtor_cv.wait(lock, [&]() { return !data.is_running; });
 			}
-			data->is_alive = false;
-			if (data->holder != nullptr) {
-				*data->holder = data->last_holder_value;
+			wheel().cancel(&data);
+			if (data.holder != nullptr) {
+				*data.holder = data.last_holder_value;
 			}
 		}
 
 		// Runs a callback in `ms` with no `timer_t` object.
 		static void wait_detached(uint32_t ms, callback_t callback) {
-			std::lock_guard<std::mutex> lock(global_mutex());
-			start_or_join_timer(std::make_shared<timer_data_t>(
-				std::chrono::steady_clock::now() + std::chrono::milliseconds(ms),
-				nullptr, std::move(callback)
-			));
+			auto data = new timer_data_t{clock::now() + std::chrono::milliseconds(ms), nullptr, std::move(callback)};
+			data->is_detached = true;
+			std::lock_guard<std::mutex> lock(wheel().mutex);
+			wheel().schedule(data);
 		}
 
 		// Invoked from callbacks when they are done scheduling and may need to wait
 		static void chain(void* ptr) {
-			auto& thread = *reinterpret_cast<timer_thread_t*>(ptr);
-			std::unique_lock<std::mutex> lock(global_mutex());
-			thread.maybe_run_next(lock);
+			std::lock_guard<std::mutex> lock(wheel().mutex);
+			wheel().hand_off(*static_cast<run_state_t*>(ptr));
+		}
+
+		// Invoked from a callback to run the same callback again in `ms`
+		static void rearm(void* ptr, uint32_t ms) {
+			std::lock_guard<std::mutex> lock(wheel().mutex);
+			timer_data_t* data = static_cast<run_state_t*>(ptr)->data;
+			data->timeout = clock::now() + std::chrono::milliseconds(ms);
+			wheel().schedule(data);
 		}
 
 		static void pause(void*& holder) {
-			std::lock_guard<std::mutex> lock(global_mutex());
+			std::lock_guard<std::mutex> lock(wheel().mutex);
 			if (holder != nullptr) {
 				auto& data = *static_cast<timer_data_t*>(holder);
 				data.pause();
@@ -244,12 +408,15 @@ class timer_t {
 		}
 
 		static void resume(void*& holder) {
-			std::lock_guard<std::mutex> lock(global_mutex());
+			std::lock_guard<std::mutex> lock(wheel().mutex);
 			if (holder != nullptr) {
 				auto& data = *static_cast<timer_data_t*>(holder);
 				data.resume();
-				if (data.threadless_self) {
-					start_or_join_timer(std::move(data.threadless_self));
+				if (data.is_parked) {
+					data.is_parked = false;
+					data.timeout += data.paused_duration;
+					data.paused_duration = {};
+					wheel().schedule(&data);
 				}
 			}
 		}
@@ -0,0 +1,41 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+(async function() {
+	let isolate = new ivm.Isolate;
+	let context = isolate.createContextSync();
+	let global = context.global;
+	global.setSync('global', global.derefInto());
+	isolate.compileScriptSync(`
+		'use strict';
+		global.counter = 0;
+		global.fn = function(a, b) {
+			++counter;
+			if (a === 'throw') {
+				throw new Error('nope');
+			}
+			return this === undefined ? a + b : this.value;
+		};
+		global.spin = function() { for(;;); };
+	`).runSync(context);
+	let fn = global.getSync('fn');
+
+	// Sync and async batches
+	let recv = new ivm.ExternalCopy({ value: 'recv' }).copyInto();
+	assert.deepStrictEqual(fn.applyBatchSync([ [ undefined, [ 1, 2 ] ], [ recv ], [ undefined, [ 'a', 'b' ] ] ]), [ 3, 'recv', 'ab' ]);
+	assert.deepStrictEqual(await fn.applyBatch(Array(100).fill().map((_, ii) => [ undefined, [ ii, 1 ] ])), Array(100).fill().map((_, ii) => ii + 1));
+	assert.deepStrictEqual(await fn.applyBatch([]), []);
+
+	// First error stops the batch
+	global.setSync('counter', 0);
+	assert.throws(() => fn.applyBatchSync([ [ undefined, [ 1, 1 ] ], [ undefined, [ 'throw' ] ], [ undefined, [ 1, 1 ] ] ]), /nope/);
+	assert.strictEqual(global.getSync('counter'), 2);
+
+	// Timeout covers the whole batch
+	await assert.rejects(global.getSync('spin').applyBatch([ [], [] ], { timeout: 20 }), /timed out/);
+
+	// Invalid input
+	assert.throws(() => fn.applyBatchSync([ 1 ]), TypeError);
+	console.log('pass');
+})().catch(console.error);
@@ -0,0 +1,46 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+(async function() {
+	let isolate = new ivm.Isolate;
+	let context = isolate.createContextSync();
+	let global = context.global;
+	global.setSync('global', global.derefInto());
+	isolate.compileScriptSync(`
+		global.later = function() {
+			return new Promise(resolve => global.resolve = resolve);
+		};
+		global.fail = async function() {
+			throw new Error('nope');
+		};
+		global.value = function(value) {
+			return value;
+		};
+		global.never = function() {
+			return new Promise(() => {});
+		};
+	`).runSync(context);
+
+	// Resolves after another call settles the promise, so nothing is blocked in between
+	let pending = global.getSync('later').apply(undefined, [], { promise: true });
+	await global.getSync('value').apply(undefined, [ 1 ]);
+	await global.getSync('resolve').apply(undefined, [ 'done' ]);
+	assert.strictEqual(await pending, 'done');
+
+	// Rejections are passed along
+	await assert.rejects(global.getSync('fail').apply(undefined, [], { promise: true }), /nope/);
+
+	// Non-promise values work as normal
+	assert.strictEqual(await global.getSync('value').apply(undefined, [ 2 ], { promise: true }), 2);
+
+	// Without the option the promise itself isn't transferable
+	await assert.rejects(global.getSync('never').apply(undefined, []), /transferable/);
+
+	// Disposing the isolate rejects anything still waiting
+	pending = global.getSync('never').apply(undefined, [], { promise: true });
+	await global.getSync('value').apply(undefined, [ 3 ]);
+	isolate.dispose();
+	await assert.rejects(pending, /disposed/);
+	console.log('pass');
+})().catch(console.error);
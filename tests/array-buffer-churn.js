@@ -0,0 +1,47 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+// Churn through small and large buffers to exercise the allocator's slab pools and mapped blocks
+const isolate = new ivm.Isolate({ memoryLimit: 32 });
+const context = isolate.createContextSync();
+const sizes = isolate.compileScriptSync(`
+	const sizes = [ 1, 15, 16, 17, 100, 1000, 4095, 4096, 4097, 65536, 1024 * 1024 ];
+	for (let ii = 0; ii < 2000; ++ii) {
+		const view = new Uint8Array(sizes[ii % sizes.length]);
+		if (view[0] !== 0 || view[view.length - 1] !== 0) {
+			throw new Error('Buffer was not zeroed');
+		}
+		view.fill(0xff);
+	}
+	sizes.join();
+`).runSync(context);
+assert.strictEqual(sizes, '1,15,16,17,100,1000,4095,4096,4097,65536,1048576');
+
+// Buffers transferred out of an isolate must outlive it
+const copies = [];
+context.global.setSync('ivm', ivm);
+context.global.setSync('keep', new ivm.Reference(copy => copies.push(copy)));
+isolate.compileScriptSync(`
+	for (const length of [ 16, 3000, 1024 * 1024 ]) {
+		const view = new Uint8Array(length);
+		view[0] = 1;
+		view[length - 1] = 2;
+		keep.applySync(undefined, [ new ivm.ExternalCopy(view.buffer, { transferOut: true }) ]);
+	}
+`).runSync(context);
+isolate.dispose();
+for (const copy of copies) {
+	const view = new Uint8Array(copy.copy());
+	assert.strictEqual(view[0], 1);
+	assert.strictEqual(view[view.length - 1], 2);
+}
+
+// Transferring back into another isolate hands over ownership again
+const isolate2 = new ivm.Isolate;
+const context2 = isolate2.createContextSync();
+context2.global.setSync('buffer', copies[0].copyInto({ transferIn: true }));
+assert.strictEqual(isolate2.compileScriptSync('new Uint8Array(buffer).join()').runSync(context2), '1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,2');
+isolate2.dispose();
+
+console.log('pass');
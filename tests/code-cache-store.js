@@ -0,0 +1,60 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const src = Array(20000).fill('function a(){}').join(';') + '; 1';
+
+// Entries are written on the thread pool, so give them a moment to land
+async function waitFor(predicate) {
+	for (let ii = 0; !predicate(); ++ii) {
+		assert(ii < 500, 'Timed out waiting for the code cache store');
+		await new Promise(resolve => setTimeout(resolve, 10));
+	}
+}
+
+const codeCache = fs.mkdtempSync(path.join(os.tmpdir(), 'ivm-code-cache-'));
+(async function() {
+	// First compile fills the store
+	let isolate = new ivm.Isolate({ codeCache });
+	let script = isolate.compileScriptSync(src);
+	assert.strictEqual(script.cachedData, undefined);
+	assert.strictEqual(script.cachedDataRejected, undefined);
+	let entries;
+	await waitFor(() => (entries = fs.readdirSync(codeCache)).length === 1 && !entries[0].includes('.tmp'));
+	assert(/^script-[0-9a-f]{64}$/.test(entries[0]));
+	let entry = path.join(codeCache, entries[0]);
+	let size = fs.statSync(entry).size;
+	assert(size > 0);
+
+	// Another isolate picks it up
+	isolate = new ivm.Isolate({ codeCache });
+	assert.strictEqual(isolate.compileScriptSync(src).runSync(isolate.createContextSync()), 1);
+	assert.deepStrictEqual(fs.readdirSync(codeCache), entries);
+
+	// Explicit cached data still works the same
+	script = isolate.compileScriptSync(src, { produceCachedData: true });
+	assert(script.cachedData instanceof ivm.ExternalCopy);
+	script = new ivm.Isolate({ codeCache }).compileScriptSync(src, { cachedData: new ivm.ExternalCopy(Buffer.from('garbage').buffer) });
+	assert.strictEqual(script.cachedDataRejected, true);
+
+	// A rejected entry is replaced
+	fs.writeFileSync(entry, 'garbage');
+	isolate = new ivm.Isolate({ codeCache });
+	assert.strictEqual(isolate.compileScriptSync(src).runSync(isolate.createContextSync()), 1);
+	await waitFor(() => fs.statSync(entry).size === size && fs.readdirSync(codeCache).length === 1);
+	assert.deepStrictEqual(fs.readdirSync(codeCache), entries);
+
+	// A missing directory just means no caching
+	isolate = new ivm.Isolate({ codeCache: path.join(codeCache, 'missing') });
+	assert.strictEqual(isolate.compileScriptSync(src).runSync(isolate.createContextSync()), 1);
+
+	assert.throws(() => new ivm.Isolate({ codeCache: 1 }), TypeError);
+	console.log('pass');
+})().catch(console.error).then(() => {
+	for (let file of fs.readdirSync(codeCache)) {
+		fs.unlinkSync(path.join(codeCache, file));
+	}
+	fs.rmdirSync(codeCache);
+});
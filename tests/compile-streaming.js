@@ -0,0 +1,29 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+const big = Array(100000).fill('function a(){ return 1 + 2; }').join(';') + '; 1';
+
+(async function() {
+	let isolate = new ivm.Isolate;
+	let context = isolate.createContextSync();
+
+	// Large scripts compile and run as normal
+	let script = await isolate.compileScript(big, { filename: 'big.js' });
+	assert.strictEqual(await script.run(context), 1);
+	script = await isolate.compileScript(big, { produceCachedData: true });
+	assert(script.cachedData instanceof ivm.ExternalCopy);
+
+	// Other work in the isolate isn't stuck behind the compile
+	let compiled = isolate.compileScript(big);
+	assert.strictEqual(await (await isolate.compileScript('2')).run(context), 2);
+	assert.strictEqual(await (await compiled).run(context), 1);
+
+	// Syntax errors are reported with the filename
+	await assert.rejects(isolate.compileScript(big + '; (', { filename: 'broken.js' }), /broken\.js/);
+
+	// Disposing the isolate mid-compile is safe
+	let pending = isolate.compileScript(big);
+	isolate.dispose();
+	await assert.rejects(pending, /disposed/);
+	console.log('pass');
+})().catch(console.error);
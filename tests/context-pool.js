@@ -0,0 +1,17 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+assert.throws(() => new ivm.Isolate({ contextPoolSize: -1 }), TypeError);
+
+(async function() {
+	let isolate = new ivm.Isolate({ memoryLimit: 32, contextPoolSize: 2 });
+	let script = await isolate.compileScript('this.value = (this.value || 0) + 1');
+	for (let ii = 0; ii < 50; ++ii) {
+		// Every context should look brand new
+		let context = ii % 2 ? await isolate.createContext() : isolate.createContextSync();
+		assert.strictEqual(await script.run(context), 1);
+		context.release();
+	}
+	console.log('pass');
+}()).catch(console.error);
@@ -0,0 +1,46 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+// Invalid options
+assert.throws(() => new ivm.Isolate({ cpuQuota: 1 }), TypeError);
+assert.throws(() => new ivm.Isolate({ cpuQuota: { limit: 0 } }), TypeError);
+assert.throws(() => new ivm.Isolate({ cpuQuota: { limit: 10, group: 1 } }), TypeError);
+
+function make(options) {
+	let isolate = new ivm.Isolate(options);
+	let context = isolate.createContextSync();
+	let spin = isolate.compileScriptSync('let d = Date.now() + 50; while (Date.now() < d);');
+	return () => spin.run(context);
+}
+
+(async function() {
+	// Spending more than the quota defers the next run until usage falls out of the window
+	let noisy = make({ cpuQuota: { limit: 20, window: 200 } });
+	let quiet = make();
+	await noisy();
+	let start = Date.now();
+	let quietDone;
+	await Promise.all([
+		noisy(),
+		quiet().then(() => quietDone = Date.now() - start),
+	]);
+	let noisyDone = Date.now() - start;
+	assert.ok(noisyDone >= 100, 'noisy isolate was not throttled');
+	assert.ok(quietDone < noisyDone, 'quiet isolate waited on noisy isolate');
+
+	// Groups share one quota
+	let first = make({ cpuQuota: { limit: 20, window: 200, group: 'tenant' } });
+	let second = make({ cpuQuota: { limit: 20, window: 200, group: 'tenant' } });
+	await first();
+	start = Date.now();
+	await second();
+	assert.ok(Date.now() - start >= 100, 'group quota was not shared');
+
+	// Joining a group doesn't reset its usage
+	let third = make({ cpuQuota: { limit: 20, window: 200, group: 'tenant' } });
+	start = Date.now();
+	await third();
+	assert.ok(Date.now() - start >= 50, 'joining a group reset its usage');
+	console.log('pass');
+})().catch(console.error);
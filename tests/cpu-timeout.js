@@ -0,0 +1,36 @@
+'use strict';
+let ivm = require('isolated-vm');
+
+(async function() {
+	let isolate = new ivm.Isolate;
+	let context = isolate.createContextSync();
+	let global = context.global;
+	global.setSync('global', global.derefInto());
+	global.setSync('defaultIsolateSpin', new ivm.Reference(function(timeout) {
+		let d = Date.now() + timeout;
+		while (Date.now() < d);
+	}));
+	isolate.compileScriptSync('global.spin = () => { for(;;); }').runSync(context);
+
+	// Runaway script is killed by CPU timeout
+	try {
+		isolate.compileScriptSync('spin()').runSync(context, { cpuTimeout: 20 });
+		console.log('sync did not time out');
+	} catch (err) {
+		if (!/timed out/.test(err.message)) {
+			console.log('wrong error', err);
+		}
+	}
+	try {
+		await global.getSync('spin').apply(undefined, [], { cpuTimeout: 20 });
+		console.log('async did not time out');
+	} catch (err) {
+		if (!/timed out/.test(err.message)) {
+			console.log('wrong error', err);
+		}
+	}
+
+	// Time spent outside of the isolate doesn't count
+	isolate.compileScriptSync('defaultIsolateSpin.applySync(undefined, [ 100 ])').runSync(context, { cpuTimeout: 50 });
+	console.log('pass');
+})().catch(console.error);
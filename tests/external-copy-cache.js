@@ -0,0 +1,47 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+const config = new ivm.ExternalCopy({ name: 'config', nested: { list: [ 1, 2, { deep: true } ] } });
+const isolate = new ivm.Isolate({ memoryLimit: 32 });
+const context = isolate.createContextSync();
+isolate.compileScriptSync('var seen = new Set').runSync(context);
+const check = isolate.compileScriptSync(`(function(config) {
+	'use strict';
+	seen.add(config);
+	assert(Object.isFrozen(config) && Object.isFrozen(config.nested.list[2]));
+	try {
+		config.nested.list.push(3);
+		return false;
+	} catch (err) {
+		return seen.size;
+	}
+	function assert(value) {
+		if (!value) throw new Error('Not frozen');
+	}
+})`).runSync(context, { reference: true });
+
+// Repeated copies into the same context materialize one object
+assert.strictEqual(check.applySync(undefined, [ config.copyInto({ cache: true }) ]), 1);
+assert.strictEqual(check.applySync(undefined, [ config.copyInto({ cache: true }) ]), 1);
+assert.strictEqual(check.applySync(undefined, [ config.copyInto() ]), 2);
+
+// Locally too
+assert.strictEqual(config.copy({ cache: true }), config.copy({ cache: true }));
+assert.notStrictEqual(config.copy(), config.copy());
+assert.ok(Object.isFrozen(config.copy({ cache: true }).nested));
+
+// Other contexts get their own object
+const context2 = isolate.createContextSync();
+const identity = isolate.compileScriptSync('(function(config) { return Object.isFrozen(config) && config.nested.list[1]; })').runSync(context2, { reference: true });
+assert.strictEqual(identity.applySync(undefined, [ config.copyInto({ cache: true }) ]), 2);
+
+// ..without pushing out the first context's object
+assert.strictEqual(check.applySync(undefined, [ config.copyInto({ cache: true }) ]), 2);
+
+// Primitives pass straight through, and unsupported values are rejected
+assert.strictEqual(new ivm.ExternalCopy('foo').copy({ cache: true }), 'foo');
+assert.throws(() => new ivm.ExternalCopy({ view: new Uint8Array(4) }).copy({ cache: true }), TypeError);
+assert.throws(() => config.copy({ cache: true, transferIn: true }), TypeError);
+isolate.dispose();
+console.log('pass');
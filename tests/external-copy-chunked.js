@@ -0,0 +1,36 @@
+'use strict';
+let ivm = require('isolated-vm');
+let assert = require('assert');
+
+// Round trip
+let data = Array(10000).fill().map((_, ii) => ({ ii, name: `item${ii}`, tags: [ 'a', 'b' ] }));
+let copy = new ivm.ExternalCopy(data, { chunkSize: 4096 });
+assert.deepEqual(copy.copy(), data);
+assert.deepEqual(copy.copy(), data);
+
+// Transfer in consumes the slices
+let result = copy.copy({ transferIn: true });
+assert.deepEqual(result, data);
+assert.throws(() => copy.copy());
+
+// Non-arrays are copied as usual
+assert.deepEqual(new ivm.ExternalCopy({ a: 1 }, { chunkSize: 16 }).copy(), { a: 1 });
+assert.deepEqual(new ivm.ExternalCopy([], { chunkSize: 16 }).copy(), []);
+
+// Invalid options
+assert.throws(() => new ivm.ExternalCopy([], { chunkSize: 0 }), RangeError);
+assert.throws(() => new ivm.ExternalCopy([], { chunkSize: 'big' }), TypeError);
+assert.throws(() => new ivm.ExternalCopy([ new ArrayBuffer(8) ], { chunkSize: 16, transferList: [ new ArrayBuffer(8) ] }), TypeError);
+
+// Oversized copy throws instead of disposing the isolate
+let isolate = new ivm.Isolate({ memoryLimit: 8 });
+let context = isolate.createContextSync();
+let big = new ivm.ExternalCopy(Array(1024 * 1024).fill().map(() => 'aaaaaaaaaaaaaaaa'), { chunkSize: 64 * 1024 });
+assert.throws(() => context.global.setSync('big', big.copyInto()), RangeError);
+assert.equal(isolate.isDisposed, false);
+
+// A transfer which doesn't fit leaves the copy intact
+assert.throws(() => context.global.setSync('big', big.copyInto({ transferIn: true })), RangeError);
+assert.equal(isolate.isDisposed, false);
+assert.equal(big.copy().length, 1024 * 1024);
+console.log('pass');
@@ -0,0 +1,29 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const file = path.join(os.tmpdir(), `isolated-vm-${process.pid}.bin`);
+fs.writeFileSync(file, Buffer.from([ 1, 2, 3, 4, 5, 6, 7, 8 ]));
+try {
+	const copy = ivm.ExternalCopy.fromFile(file);
+	assert.strictEqual(new Uint8Array(copy.copy()).join(), '1,2,3,4,5,6,7,8');
+
+	// Writes to a transferred mapping are private
+	const isolate = new ivm.Isolate;
+	const context = isolate.createContextSync();
+	context.global.setSync('buffer', copy.copyInto({ transferIn: true }));
+	assert.strictEqual(isolate.compileScriptSync('const view = new Uint8Array(buffer); view[0] = 9; view.join()').runSync(context), '9,2,3,4,5,6,7,8');
+	assert.throws(() => copy.copy(), /Array buffer is invalid/);
+	assert.strictEqual(fs.readFileSync(file).join(), '1,2,3,4,5,6,7,8');
+	isolate.dispose();
+
+	assert.throws(() => ivm.ExternalCopy.fromFile(file + '.missing'), /Failed to open/);
+	fs.writeFileSync(file, '');
+	assert.throws(() => ivm.ExternalCopy.fromFile(file), /is empty/);
+} finally {
+	fs.unlinkSync(file);
+}
+console.log('pass');
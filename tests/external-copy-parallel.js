@@ -0,0 +1,34 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+// Odd length so the last slice is partial
+const length = 1024 * 1024 * 24 + 13;
+const view = new Uint8Array(length);
+for (let ii = 0; ii < length; ii += 4099) {
+	view[ii] = ii & 0xff;
+}
+view[length - 1] = 0x7f;
+function check(copy) {
+	assert.strictEqual(copy.length, length);
+	for (let ii = 0; ii < length; ii += 4099) {
+		assert.strictEqual(copy[ii], ii & 0xff);
+	}
+	assert.strictEqual(copy[length - 1], 0x7f);
+}
+
+ivm.ExternalCopy.setParallelCopyThreshold(1024 * 1024);
+const copy = new ivm.ExternalCopy(view);
+check(copy.copy());
+
+const isolate = new ivm.Isolate({ memoryLimit: 128 });
+const context = isolate.createContextSync();
+context.global.setSync('view', copy.copyInto());
+assert.strictEqual(isolate.compileScriptSync('view[view.length - 1]').runSync(context), 0x7f);
+isolate.dispose();
+
+ivm.ExternalCopy.setParallelCopyThreshold(0);
+check(copy.copy());
+assert.throws(() => ivm.ExternalCopy.setParallelCopyThreshold(-1), RangeError);
+assert.throws(() => ivm.ExternalCopy.setParallelCopyThreshold('big'), TypeError);
+console.log('pass');
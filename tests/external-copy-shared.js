@@ -0,0 +1,31 @@
+'use strict';
+// node-args: --harmony_sharedarraybuffer
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+const copy = new ivm.ExternalCopy(new Uint8Array([ 1, 2, 3, 4 ]).buffer);
+const isolates = Array(4).fill().map(() => {
+	const isolate = new ivm.Isolate({ memoryLimit: 8 });
+	const context = isolate.createContextSync();
+	context.global.setSync('buffer', copy.copyInto({ shared: true }));
+	return { isolate, context };
+});
+
+// Every isolate sees the same memory, and it's not counted against them
+isolates[0].isolate.compileScriptSync('new Uint8Array(buffer)[0] = 9').runSync(isolates[0].context);
+for (const { isolate, context } of isolates) {
+	assert.strictEqual(isolate.compileScriptSync('buffer instanceof SharedArrayBuffer').runSync(context), true);
+	assert.strictEqual(isolate.compileScriptSync('new Uint8Array(buffer).join()').runSync(context), '9,2,3,4');
+	assert.strictEqual(isolate.getHeapStatisticsSync().externally_allocated_size, 0);
+}
+assert.strictEqual(new Uint8Array(copy.copy({ shared: true })).join(), '9,2,3,4');
+
+// The copy can't be transferred out from under the isolates using it
+assert.throws(() => copy.copy({ transferIn: true }), /in use/);
+assert.throws(() => copy.copy({ shared: true, transferIn: true }), TypeError);
+assert.throws(() => new ivm.ExternalCopy('foo').copyInto({ shared: true }), TypeError);
+
+for (const { isolate } of isolates) {
+	isolate.dispose();
+}
+console.log('pass');
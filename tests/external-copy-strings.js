@@ -56,6 +56,16 @@ if (isolate.getHeapStatisticsSync().externally_allocated_size < 1024) {
 	console.log('isolate did not externalize');
 }
 
+// Round trip external strings back out of the isolate
+if (isolate.compileScriptSync('a').runSync(context) !== kb1) {
+	console.log('1kb bad round trip');
+}
+global.setSync('b', copy2.copyInto());
+if (isolate.compileScriptSync('b').runSync(context) !== kb2) {
+	console.log('2kb bad round trip');
+}
+global.setSync('b', null);
+
 // Force garbage collection, hopefully. Check string was collected
 global.setSync('a', null);
 isolate.compileScriptSync('gc()').runSync(context);
@@ -0,0 +1,24 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+(async function() {
+	// Plain and snapshot isolates, several at once
+	let snapshot = ivm.Isolate.createSnapshot([ { code: 'function double(x) { return x * 2 }' } ]);
+	let isolates = await Promise.all([
+		ivm.Isolate.create({ memoryLimit: 32 }),
+		ivm.Isolate.create({ snapshot }),
+		ivm.Isolate.create({ snapshot }),
+	]);
+	assert.ok(isolates[0] instanceof ivm.Isolate);
+	assert.strictEqual(isolates[0].compileScriptSync('1 + 1').runSync(isolates[0].createContextSync()), 2);
+	for (let isolate of isolates.slice(1)) {
+		let context = await isolate.createContext();
+		assert.strictEqual(await (await isolate.compileScript('double(2)')).run(context), 4);
+		isolate.dispose();
+	}
+
+	// Invalid options throw synchronously
+	assert.throws(() => ivm.Isolate.create({ memoryLimit: 1 }));
+	console.log('pass');
+}()).catch(console.error);
@@ -0,0 +1,20 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+assert.throws(() => ivm.Isolate.setPoolSize(-1), RangeError);
+assert.throws(() => ivm.Isolate.setPoolSize(1, { memoryLimit: 1 }));
+
+ivm.Isolate.setPoolSize(2, { memoryLimit: 32 });
+setTimeout(function() {
+	// Pooled and regular isolates should both work, and a drained pool falls back to building one
+	let isolates = Array(4).fill().map(() => new ivm.Isolate({ memoryLimit: 32 }));
+	isolates.push(new ivm.Isolate({ memoryLimit: 64, inspector: true }));
+	for (let isolate of isolates) {
+		let context = isolate.createContextSync();
+		assert.strictEqual(isolate.compileScriptSync('1 + 1').runSync(context), 2);
+		isolate.dispose();
+	}
+	ivm.Isolate.setPoolSize(0, { memoryLimit: 32 });
+	console.log('pass');
+}, 100);
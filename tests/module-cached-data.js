@@ -0,0 +1,42 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+// Function names must be unique since modules don't allow redeclarations
+const body = Array(20000).fill().map((_, ii) => `function a${ii}(){}`).join(';');
+const src = `${body}; export default 1;`;
+const [ major, minor, patch ] = process.versions.v8.split('.').map(Number);
+const supported = major > 6 || (major === 6 && (minor > 9 || (minor === 9 && patch >= 37)));
+
+function evaluate(isolate, module) {
+	module.instantiateSync(isolate.createContextSync(), () => {});
+	module.evaluateSync();
+	return module.namespace.getSync('default');
+}
+
+// Nothing extra without flags
+let module = new ivm.Isolate().compileModuleSync(src);
+assert.strictEqual(module.cachedData, undefined);
+assert.strictEqual(module.cachedDataRejected, undefined);
+
+// Garbage is always rejected
+module = new ivm.Isolate().compileModuleSync(src, { cachedData: new ivm.ExternalCopy(Buffer.from('garbage').buffer) });
+assert.strictEqual(module.cachedDataRejected, true);
+
+// Produce and consume
+module = new ivm.Isolate().compileModuleSync(src, { produceCachedData: true });
+if (supported) {
+	let cachedData = module.cachedData;
+	assert(cachedData instanceof ivm.ExternalCopy);
+	let isolate = new ivm.Isolate;
+	module = isolate.compileModuleSync(src, { cachedData });
+	assert.strictEqual(module.cachedDataRejected, false);
+	assert.strictEqual(evaluate(isolate, module), 1);
+
+	// Script caches don't work for modules, even with the same source
+	cachedData = new ivm.Isolate().compileScriptSync(body, { produceCachedData: true }).cachedData;
+	module = new ivm.Isolate().compileModuleSync(body, { cachedData });
+	assert.strictEqual(module.cachedDataRejected, true);
+} else {
+	assert.strictEqual(module.cachedData, undefined);
+}
+console.log('pass');
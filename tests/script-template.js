@@ -0,0 +1,46 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+(async function() {
+	let template = new ivm.ScriptTemplate('typeof counter === "undefined" ? counter = 1 : ++counter', { filename: 'counter.js' });
+
+	// Compiles into many isolates
+	let isolates = Array(10).fill().map(() => new ivm.Isolate);
+	let scripts = await Promise.all(isolates.map(isolate => template.compile(isolate)));
+	for (let ii = 0; ii < isolates.length; ++ii) {
+		let context = isolates[ii].createContextSync();
+		assert.strictEqual(scripts[ii].runSync(context), 1);
+		assert.strictEqual(template.compileSync(isolates[ii]).runSync(context), 2);
+	}
+
+	// Templates are transferable
+	let isolate = new ivm.Isolate;
+	let context = isolate.createContextSync();
+	context.global.setSync('ivm', ivm);
+	context.global.setSync('template', template);
+	context.global.setSync('isolate', isolates[0]);
+	assert.strictEqual(isolate.compileScriptSync('template.compileSync(isolate) instanceof ivm.Script').runSync(context), true);
+
+	// Disposed isolates are handled
+	isolates[1].dispose();
+	assert.throws(() => template.compileSync(isolates[1]), /disposed/);
+	let fresh = new ivm.Isolate;
+	assert.strictEqual(template.compileSync(fresh).runSync(fresh.createContextSync()), 1);
+
+	// Isolates from a snapshot keep their own code cache while mixed in with plain isolates
+	let snapshot = ivm.Isolate.createSnapshot([ { code: 'var counter = 10' } ]);
+	for (let ii = 0; ii < 4; ++ii) {
+		let mixed = new ivm.Isolate(ii % 2 ? { snapshot } : {});
+		assert.strictEqual(template.compileSync(mixed).runSync(mixed.createContextSync()), ii % 2 ? 11 : 1);
+	}
+
+	// Syntax errors are reported with the filename, for every isolate
+	let broken = new ivm.ScriptTemplate('(', { filename: 'broken.js' });
+	assert.throws(() => broken.compileSync(isolate), /broken\.js/);
+	await assert.rejects(broken.compile(isolates[2]), /broken\.js/);
+
+	assert.throws(() => new ivm.ScriptTemplate(1), TypeError);
+	assert.throws(() => template.compileSync({}), TypeError);
+	console.log('pass');
+})().catch(console.error);
@@ -0,0 +1,18 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+// An isolate blocked in `applySyncPromise` must not starve the isolates its callback waits on
+ivm.Isolate.setThreadPoolSize(1);
+const isolate = new ivm.Isolate;
+const context = isolate.createContextSync();
+const other = new ivm.Isolate;
+const otherContext = other.createContextSync();
+context.global.setSync('fn', new ivm.Reference(async function() {
+	const script = await other.compileScript('1 + 1');
+	return script.run(otherContext);
+}));
+isolate.compileScript('fn.applySyncPromise(undefined, [])').then(script => script.run(context)).then(result => {
+	assert.strictEqual(result, 2);
+	console.log('pass');
+}).catch(console.error);
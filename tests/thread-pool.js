@@ -0,0 +1,32 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+// Reserved group
+ivm.Isolate.setThreadPoolSize(1, 'reserved');
+let isolate = new ivm.Isolate({ threadPool: 'reserved' });
+let context = isolate.createContextSync();
+let script = isolate.compileScriptSync('1 + 1');
+
+// Unknown groups and invalid sizes
+assert.throws(() => new ivm.Isolate({ threadPool: 'nope' }), /does not exist/);
+assert.throws(() => ivm.Isolate.setThreadPoolSize(0), RangeError);
+
+// Run a bunch of isolates on a resized default pool alongside the reserved one
+ivm.Isolate.setThreadPoolSize(2);
+let others = Array(8).fill().map(() => {
+	let isolate = new ivm.Isolate;
+	let context = isolate.createContextSync();
+	return isolate.compileScriptSync('let ii = 0; while (++ii < 1e6); ii').run(context);
+});
+Promise.all([ script.run(context), ...others ]).then(results => {
+	assert.strictEqual(results[0], 2);
+	for (let ii = 1; ii < results.length; ++ii) {
+		assert.strictEqual(results[ii], 1e6);
+	}
+	ivm.Isolate.setThreadPoolSize(4, 'reserved');
+	return script.run(context);
+}).then(result => {
+	assert.strictEqual(result, 2);
+	console.log('pass');
+}).catch(console.error);
@@ -0,0 +1,18 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+// Many isolates timing out at once shouldn't hold each other up
+ivm.Isolate.setThreadPoolSize(16);
+let start = Date.now();
+Promise.all(Array(16).fill().map(() => {
+	let isolate = new ivm.Isolate;
+	let context = isolate.createContextSync();
+	return isolate.compileScriptSync('for(;;);').run(context, { timeout: 20 }).then(
+		() => assert.fail('did not time out'),
+		err => assert.ok(/timed out/.test(err.message)),
+	);
+})).then(() => {
+	assert.ok(Date.now() - start < 1000, 'timeouts were late');
+	console.log('pass');
+}).catch(console.error);